@@ -0,0 +1,269 @@
+#include "loader.h"
+#include "smp.h"
+#include "mem.h"
+#include "peripherals/base.h"
+#include "peripherals/aux.h"
+#include "peripherals/gpio.h"
+
+#define MBOX_READ       ((reg32 *)(PBASE + 0xB880))
+#define MBOX_STATUS     ((reg32 *)(PBASE + 0xB898))
+#define MBOX_WRITE      ((reg32 *)(PBASE + 0xB8A0))
+#define MBOX_FULL       0x80000000
+#define MBOX_EMPTY      0x40000000
+#define MBOX_TAGS       8
+
+#define TAG_GET_CLOCK_RATE  0x00030002
+#define CLOCK_UART          2
+
+//DR bits 8-11: framing, parity, break, overrun
+#define UART_DR_ERRORS  0xF00
+
+#define GPIO_ALT0       4
+#define TXD             14
+#define RXD             15
+
+//cores that made it to park in start.S, the ones that did not are left where they are
+extern volatile u32 parked[NUM_CORES];
+
+static u32 mbox[8] __attribute__((aligned(16)));
+
+static loader_header header;
+
+static u64 ticks() {
+    u64 t;
+
+    asm volatile("mrs %0, cntpct_el0" : "=r"(t));
+    return t;
+}
+
+static u64 ms_to_ticks(u32 ms) {
+    return (u64)ms * (ARCH_TIMER_FREQ / 1000);
+}
+
+//the firmware's view of the UART clock, nothing else needs the mailbox here
+static u32 uart_clock() {
+    mbox[0] = sizeof(mbox);
+    mbox[1] = 0;
+    mbox[2] = TAG_GET_CLOCK_RATE;
+    mbox[3] = 8;
+    mbox[4] = 0;
+    mbox[5] = CLOCK_UART;
+    mbox[6] = 0;
+    mbox[7] = 0;
+
+    u32 msg = BUS_ADDRESS((u32)(u64)mbox) | MBOX_TAGS;
+
+    while(*MBOX_STATUS & MBOX_FULL) ;
+    *MBOX_WRITE = msg;
+
+    while(true) {
+        while(*MBOX_STATUS & MBOX_EMPTY) ;
+
+        if (*MBOX_READ == msg) {
+            break;
+        }
+    }
+
+    //the firmware default if the call failed
+    return mbox[6] ? mbox[6] : 48000000;
+}
+
+static void uart_init() {
+    u32 clock = uart_clock();
+    u32 sel = REGS_GPIO->func_select[1];
+
+    REGS_UART->u_cr = 0;
+
+    sel &= ~((7 << ((TXD % 10) * 3)) | (7 << ((RXD % 10) * 3)));
+    sel |= (GPIO_ALT0 << ((TXD % 10) * 3)) | (GPIO_ALT0 << ((RXD % 10) * 3));
+    REGS_GPIO->func_select[1] = sel;
+
+    //divisor = clock / (16 * baud), the fraction kept in 1/64ths and rounded
+    u32 div = (u32)(((u64)clock * 4 + LOADER_BAUD / 2) / LOADER_BAUD);
+
+    REGS_UART->u_icr = UART_INT_ALL;
+    REGS_UART->u_imsc = 0;
+    REGS_UART->u_dmacr = 0;
+    REGS_UART->u_ibrd = div >> 6;
+    REGS_UART->u_fbrd = div & 0x3F;
+    REGS_UART->u_lcrh = UART_LCRH_WLEN8 | UART_LCRH_FEN;
+    REGS_UART->u_cr = UART_CR_UARTEN | UART_CR_TXE | UART_CR_RXE;
+}
+
+static void uart_send(char c) {
+    while(REGS_UART->u_fr & UART_FR_TXFF) ;
+
+    REGS_UART->u_dr = c;
+}
+
+static void uart_send_string(const char *s) {
+    while(*s) {
+        uart_send(*s++);
+    }
+}
+
+//until the last bit is on the wire, the new image will reprogram the pins
+static void uart_drain_tx() {
+    while(!(REGS_UART->u_fr & UART_FR_TXFE) || (REGS_UART->u_fr & UART_FR_BUSY)) ;
+}
+
+//swallows what the host still sends after an error, until the line is quiet
+static void uart_drain_rx() {
+    u64 quiet = ticks() + ms_to_ticks(50);
+
+    while(ticks() < quiet) {
+        if (!(REGS_UART->u_fr & UART_FR_RXFE)) {
+            (void)REGS_UART->u_dr;
+            quiet = ticks() + ms_to_ticks(50);
+        }
+    }
+
+    REGS_UART->u_rsrecr = 0;
+}
+
+//0 once len bytes are in, otherwise the LOADER_ERR_ code
+static char receive(u8 *buf, u32 len) {
+    u64 timeout = ms_to_ticks(LOADER_TIMEOUT_MS);
+    u64 deadline = ticks() + timeout;
+    u32 i = 0;
+
+    //kept tight: at 3 Mbaud a byte arrives every 3.3us and the FIFO holds 16
+    while(i < len) {
+        if (REGS_UART->u_fr & UART_FR_RXFE) {
+            if (ticks() > deadline) {
+                return LOADER_ERR_TIMEOUT;
+            }
+            continue;
+        }
+
+        u32 dr = REGS_UART->u_dr;
+
+        if (dr & UART_DR_ERRORS) {
+            return LOADER_ERR_LINE;
+        }
+
+        buf[i++] = (u8)dr;
+        deadline = ticks() + timeout;
+    }
+
+    return 0;
+}
+
+//the magic is the sync point: whatever came before it (a shell echo, line noise) is
+//skipped, ready lines go out while nothing arrives
+static void wait_magic() {
+    u32 window = 0;
+    u64 next_ready = 0;
+
+    while(window != LOADER_MAGIC) {
+        if (REGS_UART->u_fr & UART_FR_RXFE) {
+            if (ticks() >= next_ready) {
+                uart_send_string(LOADER_READY);
+                next_ready = ticks() + ms_to_ticks(LOADER_READY_MS);
+            }
+            continue;
+        }
+
+        window = (window >> 8) | ((REGS_UART->u_dr & 0xFF) << 24);
+    }
+
+    header.magic = window;
+}
+
+u32 crc32(u32 crc, const u8 *buf, u32 len) {
+    crc = ~crc;
+
+    while(len && ((u64)buf & 7)) {
+        asm("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"((u32)*buf));
+        buf++;
+        len--;
+    }
+
+    //eight bytes per instruction, aligned loads only
+    while(len >= 8) {
+        asm("crc32x %w0, %w0, %x1" : "+r"(crc) : "r"(*(const u64 *)buf));
+        buf += 8;
+        len -= 8;
+    }
+
+    while(len--) {
+        asm("crc32b %w0, %w0, %w1" : "+r"(crc) : "r"((u32)*buf));
+        buf++;
+    }
+
+    return ~crc;
+}
+
+static char check_header() {
+    if (crc32(0, (const u8 *)&header, sizeof(header) - sizeof(u32)) != header.header_crc) {
+        return LOADER_ERR_HEADER;
+    }
+
+    u64 end = (u64)header.load_addr + header.raw_size;
+
+    if (!header.raw_size || !header.packed_size || header.packed_size > LOADER_BUF_SIZE
+            || end > LOADER_IMAGE_END || (header.load_addr & 7)) {
+        return LOADER_ERR_SIZE;
+    }
+
+    return 0;
+}
+
+//one transfer, 0 with the image in place
+static char load() {
+    u8 *packed = (u8 *)(u64)LOADER_BUF;
+    u8 *image = (u8 *)(u64)header.load_addr;
+    u32 size;
+    char err;
+
+    wait_magic();
+
+    err = receive((u8 *)&header + sizeof(u32), sizeof(header) - sizeof(u32));
+    if (!err) err = check_header();
+    if (err) return err;
+
+    uart_send_string("OK");
+
+    err = receive(packed, header.packed_size);
+    if (err) return err;
+
+    if (!lz4_decompress(packed, header.packed_size, image, header.raw_size, &size)
+            || size != header.raw_size) {
+        return LOADER_ERR_DECODE;
+    }
+
+    if (crc32(0, image, size) != header.raw_crc) {
+        return LOADER_ERR_CRC;
+    }
+
+    return 0;
+}
+
+void loader_main() {
+    u64 deadline = ticks() + ms_to_ticks(100);
+
+    uart_init();
+
+    //an image landing on a core still running the old copy would take it down
+    for (u32 core=1; core<NUM_CORES; core++) {
+        while(!parked[core] && ticks() < deadline) ;
+    }
+
+    while(true) {
+        char err = load();
+
+        if (!err) {
+            break;
+        }
+
+        uart_send('E');
+        uart_send(err);
+        uart_send_string("\r\n");
+        uart_drain_rx();
+    }
+
+    uart_send_string("OK");
+    uart_drain_tx();
+
+    boot_image(header.load_addr);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+//Serial chainloader. Installed once as kernel8.img, it moves itself out of the way
+//to LOADER_BASE and waits on the PL011 (GPIO 14/15) at LOADER_BAUD for
+//tools/chainload.py to push an LZ4 compressed image. The image is checked against
+//its CRC32 and entered at EL3 on every core, the same state the armstub hands over.
+//
+//It runs at EL3 with the MMU off, every data access is Device memory: no unaligned
+//accesses (-mstrict-align) and nothing is cached, the receive loop is kept short.
+
+//keep in sync with linker.ld
+#define LOADER_BASE         0x04000000
+#define LOADER_SIZE         0x00100000      //code, data and core 0's stack
+#define LOADER_STACK_TOP    (LOADER_BASE + LOADER_SIZE)
+
+//compressed image as received, then decompressed to its load address
+#define LOADER_BUF          LOADER_STACK_TOP
+#define LOADER_BUF_SIZE     0x01000000
+
+//an image has to end below the loader
+#define LOADER_IMAGE_END    LOADER_BASE
+
+#ifndef LOADER_BAUD
+#define LOADER_BAUD         921600
+#endif
+
+//sent every LOADER_READY_MS while nothing is arriving
+#define LOADER_READY        "chainload: ready\r\n"
+#define LOADER_READY_MS     1000
+
+//a transfer that stalls this long is dropped and the loader is ready again
+#define LOADER_TIMEOUT_MS   2000
+
+//followed by packed_size bytes of LZ4 block data, every field little endian
+#define LOADER_MAGIC        0x444C4843      //"CHLD"
+
+#ifndef __ASSEMBLER__
+
+#include "common.h"
+
+typedef struct {
+    u32 magic;
+    u32 load_addr;
+    u32 raw_size;
+    u32 packed_size;
+    u32 raw_crc;        //CRC32 (zlib polynomial) of the decompressed image
+    u32 header_crc;     //of the fields above
+} loader_header;
+
+//replies: "OK" after the header and after the image, otherwise 'E' and one of these,
+//then the loader is ready again
+#define LOADER_ERR_HEADER   'H'     //bad magic or header CRC
+#define LOADER_ERR_SIZE     'S'     //does not fit below the loader or in the buffer
+#define LOADER_ERR_LINE     'L'     //overrun, framing or parity error on the UART
+#define LOADER_ERR_TIMEOUT  'T'
+#define LOADER_ERR_DECODE   'D'     //malformed LZ4 block or wrong decompressed size
+#define LOADER_ERR_CRC      'C'
+
+//decompresses one LZ4 block, false if it is malformed or does not fit dst_size
+bool lz4_decompress(const u8 *src, u32 src_size, u8 *dst, u32 dst_size, u32 *out_size);
+
+u32 crc32(u32 crc, const u8 *buf, u32 len);
+
+//start.S: releases the parked secondaries into entry and follows them
+void boot_image(u64 entry);
+
+#endif
@@ -0,0 +1,77 @@
+#include "loader.h"
+
+//LZ4 block format: sequences of a token (literal length << 4 | match length - 4),
+//the literals, a 16-bit offset back into the output and the match. A nibble of 15
+//continues in bytes of 255 until a smaller one. The last sequence has literals only.
+
+static bool lz4_length(const u8 **src, const u8 *end, u32 *len) {
+    u8 b;
+
+    do {
+        if (*src >= end) {
+            return false;
+        }
+
+        b = *(*src)++;
+        *len += b;
+    } while(b == 255);
+
+    return true;
+}
+
+bool lz4_decompress(const u8 *src, u32 src_size, u8 *dst, u32 dst_size, u32 *out_size) {
+    const u8 *end = src + src_size;
+    u8 *out = dst;
+    u8 *out_end = dst + dst_size;
+
+    while(src < end) {
+        u8 token = *src++;
+        u32 literals = token >> 4;
+
+        if (literals == 15 && !lz4_length(&src, end, &literals)) {
+            return false;
+        }
+
+        if (literals > (u32)(end - src) || literals > (u32)(out_end - out)) {
+            return false;
+        }
+
+        for (u32 i=0; i<literals; i++) {
+            *out++ = *src++;
+        }
+
+        //the last sequence stops after its literals
+        if (src == end) {
+            break;
+        }
+
+        if (end - src < 2) {
+            return false;
+        }
+
+        u32 offset = src[0] | (src[1] << 8);
+        u32 match = (token & 0xF);
+
+        src += 2;
+
+        if (match == 15 && !lz4_length(&src, end, &match)) {
+            return false;
+        }
+
+        match += 4;
+
+        if (!offset || offset > (u32)(out - dst) || match > (u32)(out_end - out)) {
+            return false;
+        }
+
+        //byte by byte: an offset below the length repeats the bytes just written
+        const u8 *from = out - offset;
+
+        for (u32 i=0; i<match; i++) {
+            *out++ = *from++;
+        }
+    }
+
+    *out_size = (u32)(out - dst);
+    return true;
+}
@@ -17,6 +17,9 @@ void gpio_pin_set_func(u8 pinNumber , GpioFunc func);
 
 void gpio_pin_enable(u8 pinNumber);
 
+//pull-up/down disable for every pin in the mask with a single setup/hold wait
+void gpio_pins_enable(u64 pinMask);
+
 void gpio_init(u8 pinNumber, GpioFunc func);
 
 void gpio_set(u8 pinNumber);
@@ -27,6 +27,7 @@ namespace Graphics {
 
         // Performance monitoring
         u32 getFrameTime() const;
+        u32 getFrameTimeUs() const;
         u32 getFrameCount() const;
 
         // Query methods
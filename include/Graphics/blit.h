@@ -0,0 +1,7 @@
+#pragma once
+
+#include "common.h"
+
+//NEON block copy/fill for pixel rows (built from blit_simd.c, FP/SIMD enabled)
+void blit_copy32(u32 *dest, const u32 *src, u32 count);
+void blit_fill32(u32 *dest, u32 value, u32 count);
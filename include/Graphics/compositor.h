@@ -3,6 +3,7 @@
 #include "common.h"
 #include "framebuffer.h"
 #include"font.h"
+#include "percpu.h"
 
 
 #define MAX_TEXT_OBJECTS 1024
@@ -11,7 +12,12 @@
 void video_mark_dirty();
 u32 video_get_frame_count();
 u32 video_get_frame_time();
+u32 video_get_frame_time_us();
+u64 video_get_frame_cycles();
 void video_render_frame();
+void video_set_render_cores(u32 cores);
+u32 video_get_render_cores();
+void render_scaling_test(u32 num_objects, u32 frames);
 
 void video_clear_all_text();
 void video_remove_text(u32 id);
@@ -22,5 +28,6 @@ u32 video_add_text(char *text, u32 x, u32 y, u32 color);
 void demo_usage();
 
 extern bool frame_dirty;
-extern u32 frame_count;
-extern u64 last_frame_time;
\ No newline at end of file
+DECLARE_PER_CPU(u32, frame_count);
+extern u64 last_frame_time;
+extern u64 last_frame_cycles;
\ No newline at end of file
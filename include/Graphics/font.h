@@ -8,6 +8,11 @@ u32 font_get_width();
 bool font_get_pixel(char ch, u32 x, u32 y);
 void video_draw_string_colored(char *s, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color);
 void video_draw_char_colored(char c, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color);
+void video_draw_string_clipped(char *s, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color,
+                               u32 clip_y0, u32 clip_y1);
+void video_draw_char_clipped(char c, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color,
+                             u32 clip_y0, u32 clip_y1);
+u32 video_string_bottom(char *s, u32 pos_x, u32 pos_y);
 void video_draw_char(char c, u32 pos_x, u32 pos_y);
 void video_draw_string(char *s, u32 pos_x, u32 pos_y);
 void init_glyph_cache();
\ No newline at end of file
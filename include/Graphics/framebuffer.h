@@ -84,6 +84,7 @@ void video_set_resolution(u32 xres, u32 yres, u32 bpp);
 void video_draw_pixel(u32 x, u32 y, u32 color);
 void video_init();
 void video_set_dma(bool b);
+bool video_get_dma();
 void video_dma();
 void do_dma(void *dest, void *src, u32 total);
 void video_draw_box(u32 x,u32 y,u32 w,u32 h,u32 color);
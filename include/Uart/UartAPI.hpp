@@ -4,6 +4,7 @@
 #include <stdarg.h>
 #include <stddef.h>
 #include "printf.h"
+#include "libcpp/fmt.hpp"
 
 namespace Uart{
 
@@ -32,6 +33,17 @@ namespace Uart{
         // Printf integration - now properly implemented
         void printf(const char* format, ...);
         void vprintf(const char* format, va_list args);
+
+        // Compile-time checked formatting, see libcpp/fmt.hpp:
+        //     getUart().print<"core {}: {:08x}\n">(core, value);
+        template <libcpp::fixed_string S, typename... Args>
+        void print(const Args&... args) {
+            libcpp::format_to<S>(*this, args...);
+        }
+
+        // Sink for format_to, to the console (this UART or the PL011): \n goes out as
+        // \r\n, blocks while the TX ring is full
+        void write(const char* buf, u32 len);
         
         // Non-blocking operations
         bool tryRecv(char& c);
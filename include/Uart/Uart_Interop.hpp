@@ -7,6 +7,7 @@
 extern "C" {
     #include "mini_uart.h"
     #include "printf.h"
+    #include "console.h"
 
 //     typedef void (*putcf)(void*, char);
 
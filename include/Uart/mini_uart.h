@@ -9,7 +9,15 @@ void uart_init();
 char uart_recv();
 void uart_send(char c);
 void uart_send_string(char *str);
+u32 uart_write(const u8 *buf, u32 len);
+u32 uart_read(u8 *buf, u32 len);
+u32 uart_available();
+u32 uart_tx_free();
+void uart_set_tx_refill(void (*refill)());
+void uart_tx_kick();
+void uart_rx_poll();
+u32 uart_rx_dropped();
 
 bool uart_is_readable();
 bool uart_is_writable();
-void uart_flush();
\ No newline at end of file
+void uart_flush();
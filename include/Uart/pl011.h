@@ -0,0 +1,29 @@
+#pragma once
+
+#include "peripherals/aux.h"
+
+#define PL011_MAX_BAUD      3000000
+
+//bytes taken by one pl011_write_dma(), each goes out as its own 32-bit word
+#define PL011_DMA_MAX       4096
+
+bool pl011_init(u32 baud);
+u32 pl011_baud();
+char pl011_recv();
+void pl011_send(char c);
+void pl011_send_string(char *str);
+u32 pl011_write(const u8 *buf, u32 len);
+u32 pl011_read(u8 *buf, u32 len);
+u32 pl011_available();
+u32 pl011_tx_free();
+void pl011_set_tx_refill(void (*refill)());
+void pl011_tx_kick();
+void pl011_rx_poll();
+u32 pl011_rx_dropped();
+
+u32 pl011_write_dma(const u8 *buf, u32 len);
+bool pl011_dma_busy();
+
+bool pl011_is_readable();
+bool pl011_is_writable();
+void pl011_flush();
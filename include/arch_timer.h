@@ -0,0 +1,68 @@
+#pragma once
+
+#include "common.h"
+#include "peripherals/base.h"
+
+//ARMv8 generic timer. The counter is system wide (same value on every core) and
+//read with one mrs instead of the two or three MMIO reads of the BCM system timer.
+//Each core also has its own virtual and physical compare timers whose IRQs come
+//in through the local interrupt controller.
+
+#define ARCH_TIMER_VIRT 0
+#define ARCH_TIMER_PHYS 1
+
+//exact tick -> ns / us ratios for the crystal (19.2MHz on the 2837, 54MHz on the 2711)
+#if RPI_VERSION == 3
+#define ARCH_TIMER_NS_MUL   625
+#define ARCH_TIMER_NS_DIV   12
+#define ARCH_TIMER_US_MUL   5
+#define ARCH_TIMER_US_DIV   96
+#else
+#define ARCH_TIMER_NS_MUL   500
+#define ARCH_TIMER_NS_DIV   27
+#define ARCH_TIMER_US_MUL   1
+#define ARCH_TIMER_US_DIV   54
+#endif
+
+//CNTx_CTL_EL0 bits
+#define ARCH_TIMER_CTL_ENABLE   (1 << 0)
+#define ARCH_TIMER_CTL_IMASK    (1 << 1)
+#define ARCH_TIMER_CTL_ISTATUS  (1 << 2)
+
+typedef void (*arch_timer_fn)(void *arg);
+
+static inline u64 arch_counter() {
+    u64 cnt;
+
+    //keep the read from being hoisted above earlier instructions
+    asm volatile("isb; mrs %0, cntvct_el0" : "=r"(cnt) : : "memory");
+    return cnt;
+}
+
+static inline u64 arch_counter_freq() {
+    u64 freq;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(freq));
+    return freq;
+}
+
+//monotonic, 64 bits of ns last ~48 years at 19.2MHz before the multiply overflows
+static inline u64 clock_ns() {
+    return arch_counter() * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV;
+}
+
+static inline u64 clock_us() {
+    return arch_counter() * ARCH_TIMER_US_MUL / ARCH_TIMER_US_DIV;
+}
+
+static inline u64 ns_to_arch_ticks(u64 ns) {
+    return ns * ARCH_TIMER_NS_DIV / ARCH_TIMER_NS_MUL;
+}
+
+void arch_timer_init();
+void arch_timer_init_core();
+
+void arch_timer_start_at(u32 timer, u64 counter, arch_timer_fn fn, void *arg);
+void arch_timer_start(u32 timer, u64 delay_ns, arch_timer_fn fn, void *arg);
+void arch_timer_stop(u32 timer);
+
+void arch_timer_test();
@@ -9,4 +9,7 @@ typedef uint32_t u32;
 typedef uint64_t u64;
 typedef size_t size;
 
-typedef volatile u32 reg32;
\ No newline at end of file
+typedef volatile u32 reg32;
+
+#define CACHE_LINE_SIZE 64
+#define __cacheline_aligned __attribute__((aligned(CACHE_LINE_SIZE)))
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "common.h"
+
+//PL011_CONSOLE=1 on the make line moves the console (printf, panic, the echo loop) onto
+//the PL011 at PL011_BAUD, otherwise it stays on the mini UART at 115200
+
+#if PL011_CONSOLE
+
+#include "Uart/pl011.h"
+#include "Uart/mini_uart.h"
+
+#if PL011_BAUD > PL011_MAX_BAUD
+#error "PL011_BAUD is above PL011_MAX_BAUD"
+#endif
+
+//cleared when pl011_init fails at boot (no UART clock from the firmware), the console
+//then falls back to the mini UART so there is still somewhere to print
+extern bool console_pl011;
+
+static inline void console_init() {
+    console_pl011 = pl011_init(PL011_BAUD);
+
+    if (!console_pl011) {
+        uart_init();
+        uart_send_string((char *)"PL011 console setup failed, staying on the mini UART\n");
+    }
+}
+
+static inline void console_send(char c) { if (console_pl011) pl011_send(c); else uart_send(c); }
+static inline void console_send_string(char *str) { if (console_pl011) pl011_send_string(str); else uart_send_string(str); }
+static inline u32 console_write(const u8 *buf, u32 len) { return console_pl011 ? pl011_write(buf, len) : uart_write(buf, len); }
+static inline u32 console_tx_free() { return console_pl011 ? pl011_tx_free() : uart_tx_free(); }
+static inline void console_set_tx_refill(void (*refill)()) { if (console_pl011) pl011_set_tx_refill(refill); else uart_set_tx_refill(refill); }
+static inline void console_tx_kick() { if (console_pl011) pl011_tx_kick(); else uart_tx_kick(); }
+static inline char console_recv() { return console_pl011 ? pl011_recv() : uart_recv(); }
+static inline bool console_is_readable() { return console_pl011 ? pl011_is_readable() : uart_is_readable(); }
+static inline void console_flush() { if (console_pl011) pl011_flush(); else uart_flush(); }
+
+//bulk output paced by DMA, 0 while the previous transfer is still going
+#define CONSOLE_DMA_MAX PL011_DMA_MAX
+static inline u32 console_write_dma(const u8 *buf, u32 len) { return console_pl011 ? pl011_write_dma(buf, len) : 0; }
+static inline bool console_dma_busy() { return pl011_dma_busy(); }
+
+#else
+
+#include "Uart/mini_uart.h"
+
+static inline void console_init() { uart_init(); }
+static inline void console_send(char c) { uart_send(c); }
+static inline void console_send_string(char *str) { uart_send_string(str); }
+static inline u32 console_write(const u8 *buf, u32 len) { return uart_write(buf, len); }
+static inline u32 console_tx_free() { return uart_tx_free(); }
+static inline void console_set_tx_refill(void (*refill)()) { uart_set_tx_refill(refill); }
+static inline void console_tx_kick() { uart_tx_kick(); }
+static inline char console_recv() { return uart_recv(); }
+static inline bool console_is_readable() { return uart_is_readable(); }
+static inline void console_flush() { uart_flush(); }
+
+//the mini UART has no DREQ, everything goes through the TX ring
+#define CONSOLE_DMA_MAX 0
+
+#endif
+
+//blocking: what does not fit the TX ring goes out through the polling path of console_send
+static inline void console_write_all(const u8 *buf, u32 len) {
+    while(len) {
+        u32 w = console_write(buf, len);
+
+        if (!w) {
+            console_send(*buf);
+            w = 1;
+        }
+
+        buf += w;
+        len -= w;
+    }
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "common.h"
+#include "smp.h"
+
+//PMU cycle counter (PMCCNTR_EL0), per core and counting at the CPU clock.
+//pmu_init_core() enables it on every core and opens it to EL0.
+
+//PMCR_EL0 bits
+#define PMCR_E      (1 << 0)    //enable
+#define PMCR_P      (1 << 1)    //reset the event counters
+#define PMCR_C      (1 << 2)    //reset the cycle counter
+#define PMCR_LC     (1 << 6)    //64-bit cycle counter overflow
+
+#define PMCNTEN_CYCLES  (1U << 31)
+
+//event counters 0-3, common architectural events present on the A53 and the A72
+#define PMU_EVENTS          4
+#define PMU_EV_L1D_REFILL   0x03
+#define PMU_EV_INST_RETIRED 0x08
+#define PMU_EV_BR_MIS_PRED  0x10
+#define PMU_EV_L2D_REFILL   0x17
+
+#define PMU_EVENT_LIST { PMU_EV_INST_RETIRED, PMU_EV_L1D_REFILL, PMU_EV_L2D_REFILL, PMU_EV_BR_MIS_PRED }
+
+//PMUSERENR_EL0 bits
+#define PMUSERENR_EN    (1 << 0)
+#define PMUSERENR_CR    (1 << 2)
+
+static inline u64 cycles_now() {
+    u64 cycles;
+
+    asm volatile("isb; mrs %0, pmccntr_el0" : "=r"(cycles) : : "memory");
+    return cycles;
+}
+
+//a line per core: every core updates its row of a shared site on each scope
+typedef struct {
+    u64 count;
+    u64 total;
+    u64 min;
+    u64 max;
+} __cacheline_aligned cycle_stats;
+
+//cycles and PMU_EVENT_LIST counts of one core between pmu_events_start() and _read()
+typedef struct {
+    u64 cycles;
+    u32 events[PMU_EVENTS];
+} pmu_sample;
+
+//one per CYCLE_SCOPE, each core only writes its own row so no atomics are needed
+typedef struct cycle_site {
+    const char *name;
+    bool registered;
+    struct cycle_site *next;
+    cycle_stats per_core[NUM_CORES];
+} cycle_site;
+
+typedef struct {
+    cycle_site *site;
+    u64 start;
+} cycle_scope;
+
+#define CYCLE_SITE_INIT(n) { .name = (n) }
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void pmu_init_core();
+void pmu_calibrate();
+u64 cycles_to_ns(u64 cycles);
+u32 cpu_cycles_per_us();
+
+//calling core only, run them through ipi_call() for the others
+void pmu_events_start(pmu_sample *sample);
+void pmu_events_read(pmu_sample *sample);
+
+void cycle_site_record(cycle_site *site, u64 cycles);
+void cycle_site_reset(cycle_site *site);
+void cycle_report();
+void cycle_report_reset();
+
+#ifdef __cplusplus
+}
+#endif
+
+static inline cycle_scope cycle_scope_begin(cycle_site *site) {
+    cycle_scope scope = { site, cycles_now() };
+    return scope;
+}
+
+static inline void cycle_scope_end(cycle_scope *scope) {
+    cycle_site_record(scope->site, cycles_now() - scope->start);
+}
+
+#define CYCLE_CONCAT_(a, b) a##b
+#define CYCLE_CONCAT(a, b) CYCLE_CONCAT_(a, b)
+
+//times the rest of the enclosing block, C++ gets an RAII version from libcpp/cycle_scope.hpp
+#ifndef __cplusplus
+#define CYCLE_SCOPE(name)                                                                   \
+    static cycle_site CYCLE_CONCAT(__cycle_site_, __LINE__) = CYCLE_SITE_INIT(name);        \
+    cycle_scope CYCLE_CONCAT(__cycle_scope_, __LINE__) __attribute__((cleanup(cycle_scope_end))) \
+        = cycle_scope_begin(&CYCLE_CONCAT(__cycle_site_, __LINE__))
+#endif
@@ -2,11 +2,26 @@
 
 #include "peripherals/dma.h"
 
-typedef struct{
+typedef struct dma_channel dma_channel;
+
+//runs in the DMA IRQ (core 0) once a started transfer has finished
+typedef void (*dma_callback)(dma_channel *channel, void *ctx);
+
+struct dma_channel{
     u32 channel;
     dma_control_block * block;
     bool status;
-}dma_channel;
+    volatile u32 seq;       //transfers started
+    volatile u32 done_seq;  //transfers seen completing
+    dma_callback callback;
+    void *callback_ctx;
+
+    //dma_report() window, busy_since is the generic counter at dma_start, 0 when idle
+    u64 busy_since;
+    u64 busy_ticks;
+    u64 bytes;
+    u32 transfers;
+};
 
 typedef enum{
     CT_NONE = -1,
@@ -16,5 +31,10 @@ typedef enum{
 dma_channel * dma_open_channel(u32 channel);
 void dma_close_channel(dma_channel* channel);
 void dma_setup_mem_copy(dma_channel* channel,void*dest,void*src,u32 length,u32 burst_length);
+void dma_setup_dev_write(dma_channel *channel, u32 dev_addr, void *src, u32 length, u32 dreq);
+void dma_set_callback(dma_channel *channel, dma_callback callback, void *ctx);
 void dma_start (dma_channel *channel);
-bool dma_wait (dma_channel *channel);
\ No newline at end of file
+bool dma_wait (dma_channel *channel);
+
+//transfers, bytes and busy time of the open channels since the previous report
+void dma_report();
@@ -23,5 +23,8 @@
 #define FIQ_INVALID_EL0_32		14 
 #define ERROR_INVALID_EL0_32	15 
 
-//stack frame size
-#define S_FRAME_SIZE			256
\ No newline at end of file
+//stack frame size: x0-x30, ELR_EL1, SPSR_EL1
+#define S_FRAME_SIZE			272
+
+//FIQ frame: x0-x18, x29, x30, the handler preserves the rest
+#define FIQ_FRAME_SIZE			176
\ No newline at end of file
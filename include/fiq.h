@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common.h"
+#include "irq.h"
+
+//One interrupt source at a time can be taken as FIQ instead of IRQ. The FIQ entry
+//only saves the caller-saved registers, runs on a per-core stack of its own (held in
+//SP_EL0, so switching costs no register) and calls the handler directly, no table.
+//
+//FIQs are not masked by irq_save()/spin_lock_irqsave(): a FIQ handler must not take
+//any lock or touch state that IRQ-masked code assumes it owns. Keep it to the device
+//registers and single-writer data.
+//
+//They stay open inside IRQ handlers and the bottom halves too: kernel_entry unmasks
+//FIQs once ELR/SPSR are saved, kernel_exit masks them again before restoring them.
+
+#define FIQ_STACK_SIZE 4096
+
+typedef struct {
+    u32 count;
+    u32 max_cycles;
+    u64 total_cycles;
+} fiq_stat;
+
+//sets this core's FIQ stack and unmasks FIQs
+void fiq_init_core();
+
+//VC/ARM sources are routed to core 0, local sources (timers, mailboxes) on the calling
+//core; the source is taken away from the IRQ path until fiq_release()
+bool fiq_claim(u32 irq, irq_handler handler, void *ctx);
+void fiq_release();
+
+fiq_stat *fiq_get_stat(u32 core);
+
+void fiq_enable();
+void fiq_disable();
+
+void fiq_latency_test(u32 samples);
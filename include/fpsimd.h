@@ -0,0 +1,38 @@
+#pragma once
+
+#include "common.h"
+
+//FP/SIMD is enabled lazily. Only the *_simd.c translation units are built without
+//-mgeneral-regs-only. CPACR_EL1 traps the first FP/SIMD instruction of each
+//context (thread or IRQ), and the Q registers are saved only if another context
+//already has live state in them. An IRQ that never touches NEON pays one CPACR
+//write on entry and one on exit, and only when the interrupted code was using NEON.
+//
+//FIQ handlers must not use FP/SIMD: they run on SP_EL0 and a trap from there is fatal.
+
+//thread + nested IRQ levels (bottom halves run with IRQs on)
+#define FPSIMD_MAX_DEPTH 4
+
+typedef struct {
+    u64 q[32][2];
+    u64 fpsr;
+    u64 fpcr;
+} fpsimd_state;
+
+typedef struct {
+    u32 traps;
+    u32 saves;
+    u32 restores;
+} fpsimd_stats;
+
+void fpsimd_init_core();
+
+//bracket every IRQ, the dispatcher itself never touches FP/SIMD
+void fpsimd_irq_enter();
+void fpsimd_irq_exit();
+
+fpsimd_stats *fpsimd_get_stats(u32 core);
+void fpsimd_report();
+
+void fpsimd_save_regs(fpsimd_state *state);
+void fpsimd_load_regs(fpsimd_state *state);
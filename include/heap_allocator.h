@@ -1,9 +1,22 @@
 #pragma once
 
 #include "common.h"
+#include "mem.h"
 
 #define HEAP_TEST_COUNT 2048
 
+//small requests are served from per-core object magazines, one per size class,
+//backed by a global depot that is refilled by carving single pages
+#define HEAP_NUM_CLASSES        6
+#define HEAP_MAX_CLASS_SIZE     512
+#define HEAP_MAGAZINE_SIZE      32
+#define HEAP_MAGAZINE_BATCH     16
+
+//heap_block_t.free values, slab objects never sit on free_list
+#define HEAP_BLOCK_USED 0
+#define HEAP_BLOCK_FREE 1
+#define HEAP_BLOCK_SLAB 2
+
 typedef struct heap_block {
     size_t size;
     struct heap_block *next;
@@ -14,4 +27,5 @@ void heap_init();
 void *malloc(size_t size);      
 void free(void *ptr);
 static heap_block_t* heap_expand();
-void heap_stress_test();
\ No newline at end of file
+void heap_stress_test();
+cache_stats *heap_cache_stats(u32 core);
\ No newline at end of file
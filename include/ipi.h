@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common.h"
+
+//mailbox 0 bit layout of the target core:
+//bits 0-3 function call pending from core n, then the message types
+#define IPI_CALL_BIT(sender)    (1 << (sender))
+#define IPI_RESCHEDULE          (1 << 4)
+#define IPI_WAKEUP              (1 << 5)
+
+#define IPI_MAILBOX 0
+
+typedef void (*ipi_func)(void *arg);
+
+typedef struct {
+    u32 sent;
+    u32 received;
+    u32 calls;
+} ipi_stats;
+
+void ipi_init_core();
+
+void ipi_send(u32 core_mask, u32 message);
+//func runs on the other cores from a softirq, IRQs enabled; with wait the caller spins
+//until every one of them has returned
+void ipi_call(u32 core_mask, ipi_func func, void *arg, bool wait);
+
+bool ipi_need_resched();
+ipi_stats *ipi_get_stats(u32 core);
+
+void ipi_latency_test(u32 iterations);
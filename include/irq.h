@@ -1,7 +1,100 @@
 #pragma once
 
+#include "common.h"
+
+//IRQ numbers: VC peripherals 0-63, ARM side (basic/ARMC) 64-95, per-core local sources 96-127
+#define IRQ_VC(n)               (n)
+#define IRQ_ARM(n)              (64 + (n))
+#define IRQ_LOCAL(n)            (96 + (n))
+#define NR_IRQS                 128
+
+#define IRQ_SYS_TIMER(n)        IRQ_VC(n)
+#define IRQ_DMA(channel)        IRQ_VC(16 + (channel))
+#define IRQ_AUX                 IRQ_VC(29)
+#define IRQ_I2C                 IRQ_VC(53)
+#define IRQ_UART                IRQ_VC(57)
+#define IRQ_ARM_MAILBOX         IRQ_ARM(1)
+#define IRQ_LOCAL_CNTPNS        IRQ_LOCAL(1)
+#define IRQ_LOCAL_CNTV          IRQ_LOCAL(3)
+#define IRQ_LOCAL_MAILBOX(n)    IRQ_LOCAL(4 + (n))
+
+typedef void (*irq_handler)(u32 irq, void *ctx);
+
+//register frame kernel_entry pushes (S_FRAME_SIZE), handed to handle_irq()
+typedef struct {
+    u64 regs[31];       //x0-x30
+    u64 elr;
+    u64 spsr;
+    u64 pad;
+} irq_frame;
+
+typedef struct {
+    u32 count;
+    u32 max_cycles;
+    u64 total_cycles;
+} irq_stat;
+
 void irq_enable();
 void irq_init_vectors();
 void irq_disable();
 
-void enable_interrupt_controller(); 
\ No newline at end of file
+bool irq_register(u32 irq, irq_handler handler, void *ctx);
+void irq_unregister(u32 irq);
+
+irq_stat *irq_get_stat(u32 irq, u32 core);
+void irq_report();
+
+//generic counter value when handle_irq() last started on this core
+u64 irq_entry_time();
+
+//frame of the code the IRQ being handled on this core interrupted, NULL outside IRQs
+irq_frame *irq_get_frame();
+
+#define DAIF_IRQ_MASKED (1 << 7)
+
+//longest stretch this core ran with IRQs masked: hard IRQ handlers and
+//irq_save() sections, site is where the stretch ended
+typedef struct {
+    u32 max_cycles;
+    u64 max_site;
+} irqoff_stat;
+
+void irqoff_begin();
+void irqoff_end();
+void irqoff_record(u64 cycles, u64 site);
+irqoff_stat *irqoff_get_stat(u32 core);
+void irqoff_report();
+
+//untracked, for masking around WFI where the time spent is idle, not latency
+static inline u64 irq_save_notrace() {
+    u64 daif;
+    asm volatile("mrs %0, daif\n\tmsr daifset, #2" : "=r"(daif) :: "memory");
+    return daif;
+}
+
+static inline void irq_restore_notrace(u64 daif) {
+    asm volatile("msr daif, %0" :: "r"(daif) : "memory");
+}
+
+//masks IRQs on this core, returns the previous DAIF for irq_restore()
+static inline u64 irq_save() {
+    u64 daif = irq_save_notrace();
+
+    if (!(daif & DAIF_IRQ_MASKED)) {
+        irqoff_begin();
+    }
+    return daif;
+}
+
+static inline void irq_restore(u64 daif) {
+    if (!(daif & DAIF_IRQ_MASKED)) {
+        irqoff_end();
+    }
+    irq_restore_notrace(daif);
+}
+
+static inline bool irq_disabled() {
+    u64 daif;
+    asm volatile("mrs %0, daif" : "=r"(daif));
+    return (daif & DAIF_IRQ_MASKED) != 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "common.h"
+
+//Interrupt path benchmark: system timer compare[1] is armed at known counter values on
+//core 0 and the delay from the match to each stage is collected in a histogram.
+//Optional background load runs on the secondary cores (and DMA completion IRQs on core 0).
+
+#define LAT_LOAD_NONE       0
+#define LAT_LOAD_DMA        (1 << 0)    //back to back DMA copies, completion IRQs on core 0
+#define LAT_LOAD_UART       (1 << 1)    //a core keeps the UART transmitter busy
+#define LAT_LOAD_RENDER     (1 << 2)    //a core streams pixel blits through memory
+#define LAT_LOAD_ALL        (LAT_LOAD_DMA | LAT_LOAD_UART | LAT_LOAD_RENDER)
+
+#define LAT_BUCKETS         64
+#define LAT_BUCKET_NS       250
+
+typedef enum {
+    LAT_STAGE_ENTRY,        //handle_irq() starts
+    LAT_STAGE_HANDLER,      //the registered handler runs
+    LAT_STAGE_RETURN,       //back in the interrupted code
+    LAT_STAGES
+} lat_stage;
+
+typedef struct {
+    u32 buckets[LAT_BUCKETS + 1];   //last one is everything beyond the range
+    u32 count;
+    u32 max_ns;
+} lat_hist;
+
+void irq_latency_test(u32 samples, u32 load);
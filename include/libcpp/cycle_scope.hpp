@@ -0,0 +1,29 @@
+#ifndef CYCLE_SCOPE_HPP
+#define CYCLE_SCOPE_HPP
+
+#include "libcpp/types.h"
+#include "cycles.h"
+
+namespace libcpp {
+
+// RAII twin of the C CYCLE_SCOPE: records the cycles between construction and
+// the end of the enclosing block into a function-local static site.
+class CycleScope {
+    cycle_site* site;
+    u64 start;
+
+public:
+    explicit CycleScope(cycle_site* s) : site(s), start(cycles_now()) {}
+    ~CycleScope() { cycle_site_record(site, cycles_now() - start); }
+
+    CycleScope(const CycleScope&) = delete;
+    CycleScope& operator=(const CycleScope&) = delete;
+};
+
+}
+
+#define CYCLE_SCOPE(name)                                                                   \
+    static cycle_site CYCLE_CONCAT(__cycle_site_, __LINE__) = CYCLE_SITE_INIT(name);        \
+    libcpp::CycleScope CYCLE_CONCAT(__cycle_scope_, __LINE__)(&CYCLE_CONCAT(__cycle_site_, __LINE__))
+
+#endif
@@ -0,0 +1,394 @@
+#ifndef FMT_HPP
+#define FMT_HPP
+
+#include "libcpp/types.h"
+
+// Compile-time checked formatting in the style of {fmt}:
+//
+//     char buf[32];
+//     libcpp::format_to<"FPS: {} ({:08x})">(buf, fps, flags);
+//
+// The format string is a template argument. The compiler splits it into literal
+// runs and fields once and checks every argument type against its field, so a bad
+// string or a wrong argument is a compile error. At run time only the pre-split
+// pieces are walked: nothing is parsed and no varargs are involved.
+//
+// Fields are {} or {:[fill][<>][0][width][type]}, type one of d x X c s p.
+// {{ and }} are literal braces. Output goes to a char array (truncated, always
+// terminated) or to any sink with a write(const char *, u32) member.
+//
+// Needs C++20 (class type template arguments, consteval).
+
+namespace libcpp {
+
+template <decltype(sizeof(0)) N>
+struct fixed_string {
+    char data[N] = {};
+
+    consteval fixed_string(const char (&s)[N]) {
+        for (decltype(N) i = 0; i < N; i++) data[i] = s[i];
+    }
+
+    static constexpr u32 size = N - 1;
+};
+
+namespace fmt_detail {
+
+// deliberately not constexpr: reaching one while checking a format string at
+// compile time stops the build and the message shows up in the diagnostic
+void format_error(const char *why);
+
+enum class arg_kind : u8 { sint, uint, chr, boolean, str, ptr };
+
+template <typename T> struct kind_of;   // undefined: the type cannot be formatted
+
+template <arg_kind K> struct kind_is { static constexpr arg_kind value = K; };
+
+template <> struct kind_of<bool>               : kind_is<arg_kind::boolean> {};
+template <> struct kind_of<char>               : kind_is<arg_kind::chr> {};
+template <> struct kind_of<signed char>        : kind_is<arg_kind::sint> {};
+template <> struct kind_of<short>              : kind_is<arg_kind::sint> {};
+template <> struct kind_of<int>                : kind_is<arg_kind::sint> {};
+template <> struct kind_of<long>               : kind_is<arg_kind::sint> {};
+template <> struct kind_of<long long>          : kind_is<arg_kind::sint> {};
+template <> struct kind_of<unsigned char>      : kind_is<arg_kind::uint> {};
+template <> struct kind_of<unsigned short>     : kind_is<arg_kind::uint> {};
+template <> struct kind_of<unsigned int>       : kind_is<arg_kind::uint> {};
+template <> struct kind_of<unsigned long>      : kind_is<arg_kind::uint> {};
+template <> struct kind_of<unsigned long long> : kind_is<arg_kind::uint> {};
+template <> struct kind_of<char *>             : kind_is<arg_kind::str> {};
+template <> struct kind_of<const char *>       : kind_is<arg_kind::str> {};
+template <decltype(sizeof(0)) N> struct kind_of<char[N]>       : kind_is<arg_kind::str> {};
+template <decltype(sizeof(0)) N> struct kind_of<const char[N]> : kind_is<arg_kind::str> {};
+template <typename T> struct kind_of<T *>      : kind_is<arg_kind::ptr> {};
+
+struct arg {
+    arg_kind kind;
+    u8 size;        // sizeof the argument, {:x} shows a negative one in its own width
+    union {
+        s64 i;
+        u64 u;
+        const char *s;
+        const void *p;
+    };
+};
+
+template <typename T>
+constexpr arg make_arg(const T &v) {
+    constexpr arg_kind kind = kind_of<T>::value;
+    arg a{};
+
+    a.kind = kind;
+    a.size = sizeof(T);
+    if constexpr (kind == arg_kind::sint) a.i = v;
+    else if constexpr (kind == arg_kind::chr) a.u = (u8)v;
+    else if constexpr (kind == arg_kind::uint || kind == arg_kind::boolean) a.u = v;
+    else if constexpr (kind == arg_kind::str) a.s = v;
+    else a.p = v;
+
+    return a;
+}
+
+// a literal run (offset into text) followed by a field, the last piece has no field
+struct piece {
+    u16 lit_begin;
+    u16 lit_len;
+    char type;      // 0: the argument's default presentation
+    char fill;
+    char align;     // '<', '>', 0: numbers right, text left
+    bool zero;
+    u8 width;
+};
+
+template <u32 Fields, u32 Text>
+struct parsed {
+    piece pieces[Fields + 1] = {};
+    char text[Text + 1] = {};
+};
+
+template <fixed_string S>
+consteval u32 count_fields() {
+    u32 fields = 0;
+
+    for (u32 i = 0; i < S.size; i++) {
+        char c = S.data[i];
+
+        if (c == '{' && S.data[i + 1] == '{') i++;
+        else if (c == '}' && S.data[i + 1] == '}') i++;
+        else if (c == '}') format_error("unmatched '}' in format string");
+        else if (c == '{') {
+            while (i < S.size && S.data[i] != '}') i++;
+            if (i == S.size) format_error("unterminated '{' in format string");
+            fields++;
+        }
+    }
+
+    return fields;
+}
+
+template <fixed_string S>
+consteval auto parse() {
+    parsed<count_fields<S>(), S.size> out;
+    u32 t = 0;
+    u32 f = 0;
+    u32 i = 0;
+
+    out.pieces[0].lit_begin = 0;
+
+    while (i < S.size) {
+        char c = S.data[i];
+
+        if ((c == '{' || c == '}') && S.data[i + 1] == c) {
+            out.text[t++] = c;
+            i += 2;
+            continue;
+        }
+
+        if (c != '{') {
+            out.text[t++] = c;
+            i++;
+            continue;
+        }
+
+        piece &p = out.pieces[f];
+        p.lit_len = t - p.lit_begin;
+        p.fill = ' ';
+        i++;
+
+        if (S.data[i] == ':') {
+            i++;
+
+            if (S.data[i] != '}' && (S.data[i + 1] == '<' || S.data[i + 1] == '>')) {
+                p.fill = S.data[i];
+                p.align = S.data[i + 1];
+                i += 2;
+            } else if (S.data[i] == '<' || S.data[i] == '>') {
+                p.align = S.data[i++];
+            }
+
+            if (S.data[i] == '0') {
+                p.zero = true;
+                i++;
+            }
+
+            u32 width = 0;
+            while (S.data[i] >= '0' && S.data[i] <= '9') {
+                width = width * 10 + (S.data[i++] - '0');
+            }
+            if (width > 64) format_error("field width above 64");
+            p.width = width;
+
+            char type = S.data[i];
+            if (type == 'd' || type == 'x' || type == 'X' || type == 'c' || type == 's' || type == 'p') {
+                p.type = type;
+                i++;
+            }
+        }
+
+        if (S.data[i] != '}') format_error("bad replacement field, expected {} or {:spec}");
+        i++;
+
+        f++;
+        out.pieces[f].lit_begin = t;
+    }
+
+    out.pieces[f].lit_len = t - out.pieces[f].lit_begin;
+
+    return out;
+}
+
+template <fixed_string S>
+inline constexpr auto compiled = parse<S>();
+
+consteval bool integral(arg_kind k) {
+    return k == arg_kind::sint || k == arg_kind::uint || k == arg_kind::chr || k == arg_kind::boolean;
+}
+
+template <fixed_string S, typename... Args>
+consteval bool check() {
+    constexpr u32 fields = count_fields<S>();
+    constexpr arg_kind kinds[] = { arg_kind::sint, kind_of<Args>::value... };
+
+    if (fields != sizeof...(Args)) format_error("argument count does not match the fields");
+
+    for (u32 i = 0; i < fields; i++) {
+        char type = compiled<S>.pieces[i].type;
+        arg_kind k = kinds[i + 1];
+
+        if ((type == 'd' || type == 'c') && !integral(k)) format_error("{:d}/{:c} need an integer");
+        if ((type == 'x' || type == 'X') && !integral(k) && k != arg_kind::ptr) format_error("{:x} needs an integer or pointer");
+        if (type == 's' && k != arg_kind::str && k != arg_kind::boolean) format_error("{:s} needs a string or bool");
+        if (type == 'p' && k != arg_kind::ptr && k != arg_kind::str) format_error("{:p} needs a pointer");
+    }
+
+    return true;
+}
+
+inline constexpr char digit_pairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+// digits written backwards from end, two at a time, no divide instruction
+inline char *to_dec(char *end, u64 n) {
+    while (n >= 100) {
+        u64 q = n / 100;    // constant divisor: a multiply by the reciprocal
+        u32 r = (u32)(n - q * 100);
+        end -= 2;
+        end[0] = digit_pairs[2 * r];
+        end[1] = digit_pairs[2 * r + 1];
+        n = q;
+    }
+
+    if (n >= 10) {
+        end -= 2;
+        end[0] = digit_pairs[2 * n];
+        end[1] = digit_pairs[2 * n + 1];
+    } else {
+        *--end = '0' + n;
+    }
+
+    return end;
+}
+
+inline char *to_hex(char *end, u64 n, bool upper) {
+    const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+
+    do {
+        *--end = digits[n & 0xF];
+        n >>= 4;
+    } while (n);
+
+    return end;
+}
+
+template <typename Sink>
+void pad(Sink &sink, char fill, u32 n) {
+    char run[16];
+
+    for (u32 i = 0; i < sizeof(run); i++) run[i] = fill;
+
+    while (n) {
+        u32 chunk = n < sizeof(run) ? n : sizeof(run);
+        sink.write(run, chunk);
+        n -= chunk;
+    }
+}
+
+template <typename Sink>
+void emit_arg(Sink &sink, const piece &p, const arg &a) {
+    char buf[24];
+    char *end = buf + sizeof(buf);
+    const char *s = end;
+    const char *prefix = "";
+    u32 plen = 0;
+    bool number = true;
+
+    char type = p.type;
+    if (!type) {
+        type = a.kind == arg_kind::chr ? 'c' : a.kind == arg_kind::str || a.kind == arg_kind::boolean ? 's'
+             : a.kind == arg_kind::ptr ? 'p' : 'd';
+    }
+
+    switch (type) {
+        case 'd':
+            if (a.kind == arg_kind::sint && a.i < 0) {
+                s = to_dec(end, 0 - (u64)a.i);
+                prefix = "-";
+                plen = 1;
+            } else {
+                s = to_dec(end, a.u);
+            }
+            break;
+        case 'x':
+        case 'X': {
+            u64 v = a.u;
+
+            if (a.kind == arg_kind::sint && a.size < sizeof(u64)) v &= (1ULL << (a.size * 8)) - 1;
+            s = to_hex(end, v, type == 'X');
+            break;
+        }
+        case 'p':
+            s = to_hex(end, a.u, false);
+            prefix = "0x";
+            plen = 2;
+            break;
+        case 'c':
+            *--end = (char)a.u;
+            s = end;
+            end = (char *)s + 1;
+            number = false;
+            break;
+        default:
+            number = false;
+            if (a.kind == arg_kind::boolean) {
+                s = a.u ? "true" : "false";
+            } else {
+                s = a.s ? a.s : "(null)";
+            }
+            end = (char *)s;
+            while (*end) end++;
+            break;
+    }
+
+    u32 len = (u32)(end - s);
+    u32 fill = p.width > len + plen ? p.width - len - plen : 0;
+    bool left = p.align ? p.align == '<' : !number;
+
+    if (fill && !left && !(p.zero && number)) pad(sink, p.fill, fill);
+    if (plen) sink.write(prefix, plen);
+    if (fill && !left && p.zero && number) pad(sink, '0', fill);
+    sink.write(s, len);
+    if (fill && left) pad(sink, p.fill, fill);
+}
+
+// the one loop every format shares, only the sink type makes a copy of it
+template <typename Sink>
+void vformat(Sink &sink, const piece *pieces, const char *text, const arg *args, u32 fields) {
+    for (u32 i = 0; ; i++) {
+        const piece &p = pieces[i];
+
+        if (p.lit_len) sink.write(text + p.lit_begin, p.lit_len);
+        if (i == fields) break;
+
+        emit_arg(sink, p, args[i]);
+    }
+}
+
+// truncates, keeps room for the terminating 0
+struct buffer_sink {
+    char *buf;
+    u32 size;
+    u32 len;
+
+    void write(const char *s, u32 n) {
+        while (n-- && len + 1 < size) buf[len++] = *s++;
+    }
+};
+
+} // namespace fmt_detail
+
+template <fixed_string S, typename Sink, typename... Args>
+void format_to(Sink &sink, const Args&... args) {
+    static_assert(fmt_detail::check<S, Args...>());
+
+    constexpr auto &fmt = fmt_detail::compiled<S>;
+    const fmt_detail::arg list[] = { fmt_detail::arg{}, fmt_detail::make_arg(args)... };
+
+    fmt_detail::vformat(sink, fmt.pieces, fmt.text, list + 1, sizeof...(Args));
+}
+
+// returns the length written, the buffer is always terminated
+template <fixed_string S, decltype(sizeof(0)) N, typename... Args>
+u32 format_to(char (&buf)[N], const Args&... args) {
+    fmt_detail::buffer_sink sink{ buf, (u32)N, 0 };
+
+    format_to<S>(sink, args...);
+    buf[sink.len] = 0;
+
+    return sink.len;
+}
+
+} // namespace libcpp
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef PERCPU_HPP
+#define PERCPU_HPP
+
+#include "libcpp/types.h"
+#include "percpu.h"
+
+// C++ face of the per-CPU section. The object itself is the template copy,
+// so it has to be declared with DEFINE_PER_CPU / __percpu:
+//
+//     static __percpu libcpp::PerCpu<u32> rx_bytes;
+//     rx_bytes.local()++;
+//     u32 total = rx_bytes.sum();
+//
+// Constant-initialisable like the rings, no constructor has to run.
+
+namespace libcpp {
+
+template <typename T>
+class PerCpu {
+    T value = {};
+
+public:
+    constexpr PerCpu() = default;
+
+    PerCpu(const PerCpu&) = delete;
+    PerCpu& operator=(const PerCpu&) = delete;
+
+    T& local() { return *this_cpu_ptr(&value); }
+    T& on(u32 cpu) { return *per_cpu_ptr(&value, cpu); }
+
+    T* operator->() { return this_cpu_ptr(&value); }
+    T& operator*() { return local(); }
+
+    // only meaningful for counters, remote copies may be mid-update
+    T sum() {
+        T total = {};
+        for (u32 cpu = 0; cpu < NUM_CORES; cpu++) {
+            total += on(cpu);
+        }
+        return total;
+    }
+
+    template <typename F>
+    void for_each(F f) {
+        for (u32 cpu = 0; cpu < NUM_CORES; cpu++) {
+            f(cpu, on(cpu));
+        }
+    }
+};
+
+}
+
+#endif
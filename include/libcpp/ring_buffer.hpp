@@ -0,0 +1,182 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include "libcpp/types.h"
+#include "common.h"
+
+// Lock-free bounded rings for handing data from IRQ handlers (or other cores)
+// to thread code. Both are constant-initialisable: a zeroed object is a valid
+// empty ring, so they can live in .bss without running constructors.
+
+namespace libcpp {
+
+template <typename T>
+inline T load_acquire(const T* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+
+template <typename T>
+inline void store_release(T* p, T v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+// Single producer / single consumer. Indices run freely and are masked on
+// access; each side only writes its own index and caches the other one on
+// its own cache line so the common case touches no shared line.
+template <typename T, u32 N>
+class SpscRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+    static constexpr u32 MASK = N - 1;
+
+    // producer line
+    alignas(CACHE_LINE_SIZE) u32 head = 0;
+    u32 cached_tail = 0;
+
+    // consumer line
+    alignas(CACHE_LINE_SIZE) u32 tail = 0;
+    u32 cached_head = 0;
+
+    alignas(CACHE_LINE_SIZE) T slots[N] = {};
+
+public:
+    constexpr SpscRing() = default;
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    static constexpr u32 capacity() { return N; }
+
+    bool push(const T& value) {
+        u32 h = head;
+
+        if (h - cached_tail == N) {
+            cached_tail = load_acquire(&tail);
+            if (h - cached_tail == N) return false;
+        }
+
+        slots[h & MASK] = value;
+        store_release(&head, h + 1);
+        return true;
+    }
+
+    bool pop(T& value) {
+        u32 t = tail;
+
+        if (t == cached_head) {
+            cached_head = load_acquire(&head);
+            if (t == cached_head) return false;
+        }
+
+        value = slots[t & MASK];
+        store_release(&tail, t + 1);
+        return true;
+    }
+
+    // Bulk variants publish the index once for the whole batch.
+    u32 write(const T* buf, u32 len) {
+        u32 h = head;
+        u32 space = N - (h - load_acquire(&tail));
+        u32 n = len < space ? len : space;
+
+        for (u32 i = 0; i < n; i++) {
+            slots[(h + i) & MASK] = buf[i];
+        }
+
+        store_release(&head, h + n);
+        return n;
+    }
+
+    u32 read(T* buf, u32 len) {
+        u32 t = tail;
+        u32 avail = load_acquire(&head) - t;
+        u32 n = len < avail ? len : avail;
+
+        for (u32 i = 0; i < n; i++) {
+            buf[i] = slots[(t + i) & MASK];
+        }
+
+        store_release(&tail, t + n);
+        return n;
+    }
+
+    u32 count() const { return load_acquire(&head) - load_acquire(&tail); }
+    bool empty() const { return count() == 0; }
+    bool full() const { return count() == N; }
+};
+
+// Bounded multi-producer / multi-consumer (Vyukov). Every cell carries a
+// sequence number; it is stored relative to the cell index so that a zeroed
+// ring is already initialised.
+template <typename T, u32 N>
+class MpmcRing {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "MpmcRing size must be a power of two");
+    static constexpr u32 MASK = N - 1;
+
+    struct Cell {
+        u32 seq;    // sequence - index
+        T data;
+    };
+
+    alignas(CACHE_LINE_SIZE) u32 enqueue_pos = 0;
+    alignas(CACHE_LINE_SIZE) u32 dequeue_pos = 0;
+    alignas(CACHE_LINE_SIZE) Cell cells[N] = {};
+
+public:
+    constexpr MpmcRing() = default;
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    static constexpr u32 capacity() { return N; }
+
+    bool push(const T& value) {
+        u32 pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+
+        while (true) {
+            Cell& cell = cells[pos & MASK];
+            s32 diff = (s32)(load_acquire(&cell.seq) + (pos & MASK) - pos);
+
+            if (diff == 0) {
+                if (__atomic_compare_exchange_n(&enqueue_pos, &pos, pos + 1, true,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    cell.data = value;
+                    store_release(&cell.seq, pos + 1 - (pos & MASK));
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // full
+            } else {
+                pos = __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    bool pop(T& value) {
+        u32 pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+
+        while (true) {
+            Cell& cell = cells[pos & MASK];
+            s32 diff = (s32)(load_acquire(&cell.seq) + (pos & MASK) - (pos + 1));
+
+            if (diff == 0) {
+                if (__atomic_compare_exchange_n(&dequeue_pos, &pos, pos + 1, true,
+                                                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                    value = cell.data;
+                    store_release(&cell.seq, pos + N - (pos & MASK));
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;   // empty
+            } else {
+                pos = __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    // Approximate under concurrent use.
+    u32 count() const {
+        return __atomic_load_n(&enqueue_pos, __ATOMIC_RELAXED) -
+               __atomic_load_n(&dequeue_pos, __ATOMIC_RELAXED);
+    }
+    bool empty() const { return count() == 0; }
+};
+
+} // namespace libcpp
+
+#endif // RING_BUFFER_HPP
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "common.h"
+
+//Deferred logging. log_*() formats into the calling core's ring and returns, no UART
+//register is touched. The rings are streamed to the console by the TX interrupt once
+//its own ring runs empty, and by cpu_idle(). A line that does not fit is counted as
+//dropped, never split. On the PL011 console a large backlog goes out as one DMA
+//transfer instead of through the TX ring.
+//
+//Levels above LOG_LEVEL (make LOG_LEVEL=n) compile to nothing, arguments included.
+//
+//make LOG_BINARY=1 skips the formatting: the format string goes into the .log_fmt
+//section of kernel8.elf (not loaded) and only a log_record with its offset and the
+//raw 32-bit arguments is queued. tools/logdecode.py turns the capture back into text.
+//Formats have to be literals there, and %s only works for strings in the image.
+
+#define LOG_ERR     0
+#define LOG_WARN    1
+#define LOG_INFO    2
+#define LOG_DEBUG   3
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL   LOG_INFO
+#endif
+
+#ifndef LOG_BINARY
+#define LOG_BINARY  0
+#endif
+
+#define LOG_LINE_MAX 128
+
+#define LOG_SYNC        0xFE        //never sent by the text path
+#define LOG_MAX_ARGS    8
+
+#define LOG_RECORD_INFO(core, level, nargs) (((core) << 6) | (((level) & 3) << 4) | (nargs))
+#define LOG_RECORD_NARGS(info)              ((info) & 0xF)
+
+//followed by nargs u32 arguments, little endian like the core
+typedef struct {
+    u8 sync;
+    u8 info;        //LOG_RECORD_INFO
+    u16 fmt;        //offset of the format string in .log_fmt
+    u32 stamp;      //low half of the generic counter
+} log_record;
+
+typedef struct {
+    u32 lines;
+    u32 bytes;
+    u32 dropped;
+} log_stat;
+
+//argument count and a cast of each one to u32, up to LOG_MAX_ARGS
+#define LOG_NARGS(...) LOG_NARGS_(_, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define LOG_NARGS_(_, _1, _2, _3, _4, _5, _6, _7, _8, n, ...) n
+
+#define LOG_CAT(a, b)   LOG_CAT_(a, b)
+#define LOG_CAT_(a, b)  a##b
+
+//records carry 32-bit arguments: a 64-bit integer would lose its top half, so it does
+//not build, cast it at the call. Pointers pass, the image and the heap are below 4 GiB
+u32 log_arg_64bit(void) __attribute__((error("64-bit log argument, LOG_BINARY records hold 32 bits")));
+
+#define LOG_ARG(x) _Generic((x), \
+        long: log_arg_64bit(), \
+        unsigned long: log_arg_64bit(), \
+        long long: log_arg_64bit(), \
+        unsigned long long: log_arg_64bit(), \
+        default: (u32)(u64)(x))
+#define LOG_MAP_0(...)
+#define LOG_MAP_1(a)        LOG_ARG(a)
+#define LOG_MAP_2(a, ...)   LOG_ARG(a), LOG_MAP_1(__VA_ARGS__)
+#define LOG_MAP_3(a, ...)   LOG_ARG(a), LOG_MAP_2(__VA_ARGS__)
+#define LOG_MAP_4(a, ...)   LOG_ARG(a), LOG_MAP_3(__VA_ARGS__)
+#define LOG_MAP_5(a, ...)   LOG_ARG(a), LOG_MAP_4(__VA_ARGS__)
+#define LOG_MAP_6(a, ...)   LOG_ARG(a), LOG_MAP_5(__VA_ARGS__)
+#define LOG_MAP_7(a, ...)   LOG_ARG(a), LOG_MAP_6(__VA_ARGS__)
+#define LOG_MAP_8(a, ...)   LOG_ARG(a), LOG_MAP_7(__VA_ARGS__)
+#define LOG_MAP(...)        LOG_CAT(LOG_MAP_, LOG_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+#if LOG_BINARY
+#define LOG_EMIT(level, fmt, ...) do { \
+        static const char log_fmt[] __attribute__((section(".log_fmt"), used)) = fmt; \
+        u32 log_args[] = { 0, LOG_MAP(__VA_ARGS__) }; \
+        log_binary(level, log_fmt, log_args + 1, LOG_NARGS(__VA_ARGS__)); \
+    } while(0)
+#else
+#define LOG_EMIT(level, fmt, ...) log_printf(level, fmt, ##__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_ERR
+#define log_err(fmt, ...)   LOG_EMIT(LOG_ERR, fmt, ##__VA_ARGS__)
+#else
+#define log_err(...)        ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_WARN
+#define log_warn(fmt, ...)  LOG_EMIT(LOG_WARN, fmt, ##__VA_ARGS__)
+#else
+#define log_warn(...)       ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_INFO
+#define log_info(fmt, ...)  LOG_EMIT(LOG_INFO, fmt, ##__VA_ARGS__)
+#else
+#define log_info(...)       ((void)0)
+#endif
+
+#if LOG_LEVEL >= LOG_DEBUG
+#define log_debug(fmt, ...) LOG_EMIT(LOG_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define log_debug(...)      ((void)0)
+#endif
+
+//after console_init(), until then lines go straight to the console
+void log_init();
+
+void log_printf(u32 level, const char *fmt, ...);
+void log_binary(u32 level, const char *fmt, const u32 *args, u32 nargs);
+
+//moves as much as the console TX ring takes, safe from any core and from IRQs
+void log_drain();
+
+//lines above level are dropped before formatting, a level above LOG_LEVEL changes nothing
+void log_set_level(u32 level);
+u32 log_get_level();
+
+log_stat *log_get_stat(u32 core);
+void log_report();
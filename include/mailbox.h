@@ -174,4 +174,5 @@ bool mailbox_generic_command(u32 tag_id, u32 id, u32 *value);
 
 bool mailbox_power_check(u32 type);
 
-bool mailbox_process(mailbox_tag *tag, u32 tag_size);
\ No newline at end of file
+bool mailbox_process(mailbox_tag *tag, u32 tag_size);
+void mailbox_init();
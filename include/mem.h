@@ -14,8 +14,26 @@ void *memcpy(void *dest, const void *src, u32 n);
 
 #define PAGE_TEST_COUNT 1024
 
+//per-core page magazine, refilled from / drained to mem_map PAGE_MAGAZINE_BATCH pages at a time
+#define PAGE_MAGAZINE_SIZE  32
+#define PAGE_MAGAZINE_BATCH 16
+
+//per-core counters shared by the page and object caches
+typedef struct {
+    u32 hits;       //served by the core's own magazine
+    u32 misses;     //had to go to the global allocator
+    u32 refills;
+    u32 drains;
+} cache_stats;
+
 void *get_free_pages(int num_pages);
 void *allocate_memory(int bytes);
 void free_memory(void *base);
 
+void *get_free_page();
+void free_page(void *page);
+cache_stats *page_cache_stats(u32 core);
+void cache_stats_report(const char *name, cache_stats *(*stats)(u32 core));
+void mem_report();
+
 void page_stress_test();
\ No newline at end of file
@@ -13,10 +13,17 @@
 #define PAGING_MEMORY 			(HIGH_MEMORY - LOW_MEMORY)
 #define PAGING_PAGES 			(PAGING_MEMORY/PAGE_SIZE)
 
+//core n stack top is LOW_MEMORY - n * CORE_STACK_SIZE
+#define CORE_STACK_SIZE         (64 * 1024)
+
+//first section holds the kernel image, mapped cacheable so exclusives work across cores
+#define KERNEL_CACHED_END       SECTION_SIZE
+
 
 #ifndef __ASSEMBLER__
 
 void memzero(unsigned long src, unsigned int n);
+void dcache_clean_invalidate_range(unsigned long start, unsigned long length);
 
 
 #endif
\ No newline at end of file
@@ -13,13 +13,16 @@
  *			n	MAIR
  *   DEVICE_nGnRnE	000	00000000
  *   NORMAL_NC		001	01000100
+ *   NORMAL_WB		010	11111111
  */
 #define MT_DEVICE_nGnRnE 		0x0
 #define MT_NORMAL_NC			0x1
+#define MT_NORMAL_WB			0x2
 #define MT_DEVICE_nGnRnE_FLAGS		0x00
 #define MT_NORMAL_NC_FLAGS  		0x44
+#define MT_NORMAL_WB_FLAGS  		0xFF
 
-#define MAIR_VALUE			(MT_DEVICE_nGnRnE_FLAGS << (8 * MT_DEVICE_nGnRnE)) | (MT_NORMAL_NC_FLAGS << (8 * MT_NORMAL_NC))
+#define MAIR_VALUE			(MT_DEVICE_nGnRnE_FLAGS << (8 * MT_DEVICE_nGnRnE)) | (MT_NORMAL_NC_FLAGS << (8 * MT_NORMAL_NC)) | (MT_NORMAL_WB_FLAGS << (8 * MT_NORMAL_WB))
 
 #define ATTRINDX_NORMAL		0
 #define ATTRINDX_DEVICE		1
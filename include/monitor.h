@@ -0,0 +1,19 @@
+#pragma once
+
+#include "common.h"
+
+//Command monitor on the console UART: line editing (backspace, ^U, ^C, up arrow
+//recalls the previous line) and a handful of introspection commands, "help" lists
+//them.
+//
+//monitor_poll() only takes what the RX ring already holds and returns. Core 0 calls
+//it between two frames of the render demo and from its idle loop afterwards, so a
+//command runs alongside the workload at the lowest priority: IRQs and bottom halves
+//preempt it as usual, and a long one (perf) only holds back the next frame.
+
+#define MONITOR_LINE_MAX    80
+#define MONITOR_MAX_ARGS    4
+
+//prints the banner and the first prompt
+void monitor_init();
+void monitor_poll();
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "common.h"
+#include "smp.h"
+
+//per-CPU variables live in .data.percpu, that section is only a template:
+//percpu_init() copies it once per core and TPIDR_EL1 holds the distance from
+//the template to the running core's copy. Always go through the accessors,
+//the template itself is never touched after boot.
+//
+//A core only ever writes its own copy, so no atomics are needed. Fields that
+//are also updated from an IRQ handler on the same core need irq_save() around
+//the read-modify-write.
+
+#define __percpu __attribute__((section(".data.percpu")))
+
+#define DEFINE_PER_CPU(type, name)  __percpu __typeof__(type) name
+#define DECLARE_PER_CPU(type, name) extern __percpu __typeof__(type) name
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern u64 percpu_offset[NUM_CORES];
+
+void percpu_init();
+void percpu_init_core(u32 core);
+
+#ifdef __cplusplus
+}
+#endif
+
+//no volatile: the offset never changes once the core is running so reads may be merged
+static inline u64 percpu_this_offset() {
+    u64 offset;
+    asm("mrs %0, tpidr_el1" : "=r"(offset));
+    return offset;
+}
+
+#define per_cpu_ptr(ptr, cpu)   ((__typeof__(ptr))((u64)(ptr) + percpu_offset[cpu]))
+#define this_cpu_ptr(ptr)       ((__typeof__(ptr))((u64)(ptr) + percpu_this_offset()))
+
+#define per_cpu(var, cpu)       (*per_cpu_ptr(&(var), cpu))
+#define this_cpu(var)           (*this_cpu_ptr(&(var)))
@@ -20,10 +20,20 @@ struct AuxRegs {
     reg32 mu_status;
     reg32 mu_baud_rate;
 };
+//mu_ier: bits 2/3 have to be set along with bit 0 or the receive interrupt never fires
+#define MU_IER_RX           0xD
+#define MU_IER_TX           0x2
+
+#define MU_LSR_DATA_READY   0x01
+#define MU_LSR_TX_EMPTY     0x20        //room for at least one byte in the TX FIFO
+#define MU_LSR_TX_IDLE      0x40        //FIFO empty and the last bit shifted out
+
 struct UartRegs{
     reg32 u_dr;      //data reg
-    reg32 reserved;
+    reg32 u_rsrecr;  //receive status / error clear
+    reg32 reserved[4];
     reg32 u_fr;      //flag reg
+    reg32 reserved1;
     reg32 u_ilpr;    // not in use
     reg32 u_ibrd;    //integer baud rate divisor
     reg32 u_fbrd;    //Fractional Baud rate divisor
@@ -34,11 +44,43 @@ struct UartRegs{
     reg32 u_ris;     //raw interrupt status reg
     reg32 u_mis;     //masked interrupt status reg
     reg32 u_icr;     //interrupt clear register
-    reg32 u_dmacr;   //dma controller regs (not supported in rpi3)
+    reg32 u_dmacr;   //dma control reg
+    reg32 reserved2[13];
     reg32 u_itcr;    //test control reg
     reg32 u_itip;    //integraton test input reg
     reg32 u_itop;    //integration test output reg
     reg32 u_tdr;     //test data reg
 };
+
+#define UART_FR_BUSY        (1 << 3)
+#define UART_FR_RXFE        (1 << 4)
+#define UART_FR_TXFF        (1 << 5)
+#define UART_FR_TXFE        (1 << 7)
+
+#define UART_LCRH_FEN       (1 << 4)
+#define UART_LCRH_WLEN8     (3 << 5)
+
+#define UART_CR_UARTEN      (1 << 0)
+#define UART_CR_TXE         (1 << 8)
+#define UART_CR_RXE         (1 << 9)
+
+//fifo level select: 0 = 1/8, 1 = 1/4, 2 = 1/2, 3 = 3/4, 4 = 7/8 of the 16 entries
+#define UART_IFLS_TX(level) ((level) << 0)
+#define UART_IFLS_RX(level) ((level) << 3)
+
+//imsc, ris, mis and icr share the layout
+#define UART_INT_RX         (1 << 4)
+#define UART_INT_TX         (1 << 5)
+#define UART_INT_RT         (1 << 6)     //receive timeout: bytes below the RX level sat for 32 bit times
+#define UART_INT_OE         (1 << 10)
+#define UART_INT_ALL        0x7FF
+
+#define UART_DMACR_TXDMAE   (1 << 1)
+
+#define UART_FIFO_SIZE      16
+
 #define REGS_AUX ((struct AuxRegs *)(PBASE + 0x00215000))
-#define REGS_UART ((struct UartRegs *)(PBASE + 0x00201000))
\ No newline at end of file
+#define REGS_UART ((struct UartRegs *)(PBASE + 0x00201000))
+
+//the data register as the DMA engine sees it
+#define UART_DR_BUS_ADDR (PBASE_BUS + 0x00201000)
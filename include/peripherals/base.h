@@ -3,16 +3,25 @@
 #if RPI_VERSION == 3
 #define PBASE 0x3F000000
 #define DEVICE_START 0x3B400000
+#define LOCAL_BASE 0x40000000
+#define ARCH_TIMER_FREQ 19200000
 
 #elif RPI_VERSION == 4
 #define PBASE 0xFE000000
 #define DEVICE_START 0xFC000000
+#define LOCAL_BASE 0xFF800000
+#define ARCH_TIMER_FREQ 54000000
 
 #else
 #define PBASE 0
 #define DEVICE_START 0
+#define LOCAL_BASE 0
+#define ARCH_TIMER_FREQ 0
 #error RPI_VERSION NOT DEFINED
 
 #endif
 
-#define CORE_CLOCK_SPEED 1500000000
\ No newline at end of file
+#define CORE_CLOCK_SPEED 1500000000
+
+//peripherals on the VC bus, what DMA control blocks are given
+#define PBASE_BUS 0x7E000000
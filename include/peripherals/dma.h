@@ -41,6 +41,8 @@ typedef struct {
 
 
 #define TI_PERMAP_SHIFT			16
+    #define DREQ_UART_TX			12
+    #define DREQ_UART_RX			14
 #define TI_BURST_LENGTH_SHIFT		12
 #define DEFAULT_BURST_LENGTH		0
 #define TI_SRC_IGNORE			(1 << 11)
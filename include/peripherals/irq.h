@@ -47,4 +47,24 @@ struct arm_irq_regs_2837 {
     typedef struct arm_irq_regs_2711 arm_irq_regs;
 #endif
 
-#define REGS_IRQ ((arm_irq_regs *)(PBASE + 0x0000B200))
\ No newline at end of file
+#define REGS_IRQ ((arm_irq_regs *)(PBASE + 0x0000B200))
+
+//2837: a single FIQ source, 0-63 VC, 64-71 ARM basic
+#define FIQ_CONTROL_ENABLE (1 << 7)
+
+//2711: FIQ0 bank, same layout as the IRQ0 one
+struct arm_fiq_regs_2711 {
+    reg32 fiq0_pending_0;
+    reg32 fiq0_pending_1;
+    reg32 fiq0_pending_2;
+    reg32 res0;
+    reg32 fiq0_enable_0;
+    reg32 fiq0_enable_1;
+    reg32 fiq0_enable_2;
+    reg32 res1;
+    reg32 fiq0_disable_0;
+    reg32 fiq0_disable_1;
+    reg32 fiq0_disable_2;
+};
+
+#define REGS_FIQ_2711 ((struct arm_fiq_regs_2711 *)(PBASE + 0x0000B300))
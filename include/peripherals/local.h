@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common.h"
+
+#include "peripherals/base.h"
+
+//BCM2836 ARM Quad-A7 control, 4.x (same layout on 2837 and 2711 ARM_LOCAL)
+struct LocalRegs {
+    reg32 control;
+    reg32 res0;
+    reg32 core_timer_prescaler;
+    reg32 gpu_int_routing;
+    reg32 pmu_int_routing_set;
+    reg32 pmu_int_routing_clr;
+    reg32 res1;
+    reg32 core_timer_ls;
+    reg32 core_timer_ms;
+    reg32 local_int_routing;
+    reg32 res2;
+    reg32 axi_outstanding_counters;
+    reg32 axi_outstanding_irq;
+    reg32 local_timer_control;
+    reg32 local_timer_write_flags;
+    reg32 res3;
+    reg32 core_timer_int_ctrl[4];
+    reg32 core_mailbox_int_ctrl[4];
+    reg32 core_irq_source[4];
+    reg32 core_fiq_source[4];
+    reg32 mailbox_set[4][4];    //write-1-to-set, [core][mailbox]
+    reg32 mailbox_rdclr[4][4];  //read / write-1-to-clear, [core][mailbox]
+};
+
+#define REGS_LOCAL ((struct LocalRegs *)(LOCAL_BASE))
+
+//core_irq_source / core_fiq_source bits
+#define LOCAL_IRQ_CNTPS         (1 << 0)
+#define LOCAL_IRQ_CNTPNS        (1 << 1)
+#define LOCAL_IRQ_CNTHP         (1 << 2)
+#define LOCAL_IRQ_CNTV          (1 << 3)
+#define LOCAL_IRQ_MAILBOX(n)    (1 << (4 + (n)))
+#define LOCAL_IRQ_GPU           (1 << 8)
+#define LOCAL_IRQ_PMU           (1 << 9)
+#define LOCAL_IRQ_AXI           (1 << 10)
+#define LOCAL_IRQ_LOCAL_TIMER   (1 << 11)
+#define LOCAL_SOURCES_MASK      0xFFF
+
+//core_timer_int_ctrl: bits 0-3 route the timers to IRQ (same order as the source bits), 4-7 to FIQ
+#define TIMER_FIQ_ENABLE(source)    ((source) << 4)
+
+//core_mailbox_int_ctrl bits
+#define MAILBOX_IRQ_ENABLE(n)   (1 << (n))
+#define MAILBOX_FIQ_ENABLE(n)   (1 << (4 + (n)))
+
+//local_timer_control: bit 28 runs the timer, bit 29 raises its interrupt
+#define LOCAL_TIMER_IRQ_ENABLE  (1 << 29)
+
+//axi_outstanding_irq: bits 0-19 timeout, bit 20 raises the interrupt
+#define AXI_IRQ_ENABLE          (1 << 20)
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "common.h"
+#include "peripherals/base.h"
+
+//power management block, only the watchdog is used: when it runs out with a full
+//reset configured the SoC restarts and the firmware boots kernel8.img again
+struct pm_regs {
+    reg32 reserved[7];
+    reg32 rstc;
+    reg32 rsts;
+    reg32 wdog;         //16-bit count of ~15us ticks
+};
+
+#define PM_PASSWORD                 0x5A000000
+#define PM_RSTC_WRCFG_MASK          0x00000030
+#define PM_RSTC_WRCFG_FULL_RESET    0x00000020
+
+#define REGS_PM ((struct pm_regs *)(PBASE + 0x00100000))
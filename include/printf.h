@@ -30,14 +30,15 @@ into your project.
 
 Two printf variants are provided: printf and sprintf. 
 
-The formats supported by this implementation are: 'd' 'u' 'c' 's' 'x' 'X'.
+The formats supported by this implementation are: 'd' 'i' 'u' 'c' 's' 'x' 'X' 'p'.
 
-Zero padding and field width are also supported.
+Zero padding, left alignment ('-'), field width ('*' too) and a precision for
+'s' are also supported. The 'l', 'll' and 'z' modifiers take 64-bit arguments.
 
-If the library is compiled with 'PRINTF_SUPPORT_LONG' defined then the 
-long specifier is also
-supported. Note that this will pull in some long math routines (pun intended!)
-and thus make your executable noticably longer.
+(This tree's copy has been reworked: output is staged in a small buffer and
+handed to a write(buf, len) sink a chunk at a time instead of a putc per
+character, and numbers are converted two digits at a time from a table with
+no divide instructions. The putc interface below still works on top of it.)
 
 The memory foot print of course depends on the target cpu, compiler and 
 compiler options, but a rough guestimate (based on a H8S target) is about 
@@ -98,15 +99,30 @@ regs Kusti, 23.10.2004
 extern "C" {
 #endif
 
+typedef void (*putcf) (void*,char);
+typedef void (*writef) (void *p, const char *buf, unsigned int len);
+
 void init_printf(void* putp,void (*putf) (void*,char));
+void init_printf_write(void *p, writef write);
+
+void tfp_printf(const char *fmt, ...);
+void tfp_sprintf(char* s,const char *fmt, ...);
+int tfp_snprintf(char *s, unsigned int size, const char *fmt, ...);
+int tfp_vsnprintf(char *s, unsigned int size, const char *fmt, va_list va);
+
+void tfp_format(void* putp,void (*putf) (void*,char),const char *fmt, va_list va);
+unsigned int tfp_format_write(void *p, writef write, const char *fmt, va_list va);
 
-void tfp_printf(char *fmt, ...);
-void tfp_sprintf(char* s,char *fmt, ...);
+//the new engine against the original tinyprintf one, both into a buffer
+void printf_benchmark();
 
-void tfp_format(void* putp,void (*putf) (void*,char),char *fmt, va_list va);
+//libcpp::format_to against snprintf, see src/util/fmt_benchmark.cpp
+void fmt_benchmark();
 
 #define printf tfp_printf 
 #define sprintf tfp_sprintf 
+#define snprintf tfp_snprintf
+#define vsnprintf tfp_vsnprintf
 #ifdef __cplusplus
 }
 #endif
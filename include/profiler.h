@@ -0,0 +1,30 @@
+#pragma once
+
+#include "common.h"
+
+//Statistical sampling profiler. Every online core arms its virtual generic timer
+//(CNTV) at a fixed rate. The tick records the interrupted ELR_EL1 and, if asked, a
+//frame pointer backtrace into a per-core buffer. prof_dump() merges identical
+//stacks and prints them over the UART. tools/profile.py symbolises the result
+//against build/kernel8.elf.
+//
+//Sampling rides on the IRQ, so code running with IRQs masked is charged to
+//the point where it unmasks them. Work handed out with ipi_call() runs in a
+//softirq with IRQs enabled, so the secondaries' share of a frame (render_tiles)
+//is sampled where it runs.
+
+#define PROF_MAX_DEPTH      8
+#define PROF_SAMPLES        4096    //per core, later samples are counted as dropped
+
+typedef struct {
+    u64 pc;
+    u64 callers[PROF_MAX_DEPTH];
+    u32 depth;
+} prof_sample;
+
+//depth 0 records the PC only
+void prof_start(u32 hz, u32 depth);
+void prof_stop();
+
+//PROFILE BEGIN/END block for tools/profile.py, the buffers are reset afterwards
+void prof_dump(const char *label);
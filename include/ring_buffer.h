@@ -0,0 +1,37 @@
+#pragma once
+
+#include "common.h"
+
+// C view of the libcpp ring templates (include/libcpp/ring_buffer.hpp)
+
+#define SPSC_RING_SIZE 4096     //bytes
+#define MPMC_RING_SIZE 256      //u64 messages
+
+#define SPSC_RING_POOL 8
+#define MPMC_RING_POOL 4
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct spsc_ring spsc_ring;     //SpscRing<u8, SPSC_RING_SIZE>
+typedef struct mpmc_ring mpmc_ring;     //MpmcRing<u64, MPMC_RING_SIZE>
+
+//rings come from static pools, NULL once the pool is used up
+spsc_ring *spsc_ring_create();
+bool spsc_ring_push(spsc_ring *ring, u8 value);
+bool spsc_ring_pop(spsc_ring *ring, u8 *value);
+u32 spsc_ring_write(spsc_ring *ring, const u8 *buf, u32 len);
+u32 spsc_ring_read(spsc_ring *ring, u8 *buf, u32 len);
+u32 spsc_ring_count(spsc_ring *ring);
+
+mpmc_ring *mpmc_ring_create();
+bool mpmc_ring_push(mpmc_ring *ring, u64 value);
+bool mpmc_ring_pop(mpmc_ring *ring, u64 *value);
+u32 mpmc_ring_count(mpmc_ring *ring);
+
+void ring_benchmark();
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,37 @@
+#pragma once
+
+#define NUM_CORES 4
+
+#ifndef __ASSEMBLER__
+
+#include "common.h"
+
+typedef void (*smp_entry_fn)(u32 core);
+
+//sense-reversing barrier, must live in cacheable memory (not on a stack)
+typedef struct {
+    u32 arrived;
+    u32 generation;
+    u32 cores;
+} smp_barrier;
+
+//release slots polled by the parked secondaries in boot.S (spin-table style)
+extern volatile u64 cpu_release_addr[NUM_CORES];
+
+static inline u32 cpu_id() {
+    u64 mpidr;
+    asm volatile("mrs %0, mpidr_el1" : "=r"(mpidr));
+    return mpidr & 0xFF;
+}
+
+void smp_init();
+bool smp_start_core(u32 core, smp_entry_fn entry);
+bool cpu_is_online(u32 core);
+u32 cpu_online_mask();
+void cpu_idle();
+
+//once, or again between rounds to change the count, never while cores are arriving
+void smp_barrier_init(smp_barrier *barrier, u32 cores);
+void smp_barrier_wait(smp_barrier *barrier);
+
+#endif
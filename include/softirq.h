@@ -0,0 +1,55 @@
+#pragma once
+
+#include "common.h"
+
+//Bottom halves. Top halves (irq_register handlers) only ack the hardware and raise a
+//softirq or schedule a tasklet. The work runs on the way out of handle_irq with IRQs
+//enabled again, so a long expiry or wakeup no longer holds off other interrupts.
+//Work still pending after SOFTIRQ_RESTARTS rounds is left to the core's idle loop,
+//so an interrupt storm cannot keep it in IRQ context forever.
+
+#define SOFTIRQ_RESTARTS 4
+
+typedef enum {
+    SOFTIRQ_TIMER,
+    SOFTIRQ_TASKLET,
+    SOFTIRQ_IPI_CALL,
+    NR_SOFTIRQS
+} softirq_nr;
+
+typedef void (*softirq_fn)();
+
+//must live in kernel .data/.bss, scheduled is claimed atomically
+typedef struct tasklet {
+    struct tasklet *next;
+    void (*fn)(void *arg);
+    void *arg;
+    bool scheduled;
+} tasklet;
+
+typedef struct {
+    u32 runs[NR_SOFTIRQS];
+    u32 deferred;       //left to the idle loop
+    u32 max_cycles;     //longest single bottom half
+} softirq_stats;
+
+void softirq_init();
+void open_softirq(softirq_nr nr, softirq_fn fn);
+
+//pending on the calling core, safe from any context
+void raise_softirq(softirq_nr nr);
+bool softirq_pending();
+
+//end of handle_irq, IRQs masked on entry and on return
+void softirq_irq_exit();
+
+//from the idle loop with IRQs enabled
+void softirq_run_pending();
+
+void tasklet_init(tasklet *t, void (*fn)(void *arg), void *arg);
+
+//runs once on the scheduling core, scheduling an already queued tasklet is a no-op
+void tasklet_schedule(tasklet *t);
+
+softirq_stats *softirq_get_stats(u32 core);
+void softirq_report();
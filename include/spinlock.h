@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common.h"
+#include "irq.h"
+
+//ticket lock, must live in cacheable memory (kernel .data/.bss, not a stack)
+typedef struct {
+    u16 next;
+    u16 owner;
+} spinlock;
+
+#define SPINLOCK_INIT {0, 0}
+
+static inline void spin_lock(spinlock *lock) {
+    u16 ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+
+    while(__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        asm volatile("wfe");
+    }
+}
+
+static inline void spin_unlock(spinlock *lock) {
+    __atomic_store_n(&lock->owner, lock->owner + 1, __ATOMIC_RELEASE);
+    asm volatile("dsb sy; sev");
+}
+
+static inline u64 spin_lock_irqsave(spinlock *lock) {
+    u64 flags = irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(spinlock *lock, u64 flags) {
+    spin_unlock(lock);
+    irq_restore(flags);
+}
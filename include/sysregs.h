@@ -52,11 +52,21 @@
 #define TCR_EL1_VAL    (TCR_TG1_4K | TCR_T1SZ | TCR_TG0_4K | TCR_T0SZ)
 
 /* architectural feature access control register */
-#define CPACR_EL1_FPEN    (1 << 21) | (1 << 20) // don't trap SIMD/FP registers
-#define CPACR_EL1_ZEN     (1 << 17) | (1 << 16)  // don't trap SVE instructions
-#define CPACR_EL1_VAL     (CPACR_EL1_FPEN | CPACR_EL1_ZEN)
+#define CPACR_EL1_FPEN    ((1 << 21) | (1 << 20)) // don't trap SIMD/FP registers
+#define CPACR_EL1_ZEN     ((1 << 17) | (1 << 16))  // don't trap SVE instructions
+#define CPACR_EL1_VAL     CPACR_EL1_ZEN // SIMD/FP traps until first use, see fpsimd.c
+
+/* Cortex-A53/A72 CPU extended control, must be set at EL3 before caches/MMU for coherency */
+#define CPUECTLR_EL1      S3_1_C15_C2_1
+#define CPUECTLR_SMPEN    (1 << 6)
+
+/* D13.8.1 CNTHCTL_EL2: let EL1 use the physical counter and timer */
+#define CNTHCTL_EL1PCTEN  (1 << 0)
+#define CNTHCTL_EL1PCEN   (1 << 1)
+#define CNTHCTL_VALUE     (CNTHCTL_EL1PCTEN | CNTHCTL_EL1PCEN)
 
 /* exception syndrome register EL1 (ESR_EL1) */
 #define ESR_ELx_EC_SHIFT 26
 #define ESR_ELx_EC_SVC64 0x15
-#define ESR_ELx_EC_DA_LOW 0x24
\ No newline at end of file
+#define ESR_ELx_EC_DA_LOW 0x24
+#define ESR_ELx_EC_FP_ASIMD 0x07
\ No newline at end of file
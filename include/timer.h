@@ -2,8 +2,41 @@
 
 #include "common.h"
 
+typedef void (*timer_fn)(void *arg);
+
+//software timer, owned by the caller and kept on the wheel until it expires.
+//Callbacks run from the timer softirq on core 0, with IRQs enabled.
+typedef struct sw_timer {
+    struct sw_timer *next;
+    struct sw_timer **pprev;    //NULL when not queued
+    u64 deadline;               //system timer ticks (us)
+    u64 period;                 //0 for one-shot
+    timer_fn fn;
+    void *arg;
+    u8 level;
+    u8 slot;
+} sw_timer;
+
+//expiry lateness against the requested deadline
+typedef struct {
+    u32 expired;
+    u32 min_late;
+    u32 max_late;
+    u64 total_late;
+} timer_wheel_stats;
+
 void timer_init();
-void handle_timer_1();
-void handle_timer_3();
 void timer_sleep(u32 ms);
-u64 timer_get_ticks();
\ No newline at end of file
+void timer_sleep_us(u64 us);
+u64 timer_get_ticks();
+u64 timer_get_systimer();
+
+void timer_setup(sw_timer *timer, timer_fn fn, void *arg);
+void timer_add(sw_timer *timer, u64 delay_us);
+void timer_add_periodic(sw_timer *timer, u64 period_us);
+bool timer_cancel(sw_timer *timer);
+bool timer_pending(sw_timer *timer);
+
+timer_wheel_stats *timer_get_wheel_stats();
+void timer_wheel_report();
+void timer_wheel_test(u32 count, u32 span_ms);
\ No newline at end of file
@@ -2,6 +2,9 @@
 #include "common.h"
 
 void delay(u64 ticks);
+void ndelay(u64 ns);
+void udelay(u64 us);
+void mdelay(u64 ms);
 void put32(u64 address , u32 val); 
 u32 get32(u64 address);
 void delay_seconds(u64 seconds);
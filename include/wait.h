@@ -0,0 +1,71 @@
+#pragma once
+
+#include "common.h"
+#include "spinlock.h"
+
+//Wait queues for code that blocks on an interrupt: the waiter queues an entry,
+//rechecks its condition and parks the core in WFI, the IRQ handler (or another
+//core) wakes it after making the condition true. Remote waiters are kicked with
+//IPI_WAKEUP. Entries live on the waiter's stack and are only touched under the
+//queue lock; the queue itself must live in cacheable memory (.data/.bss).
+
+typedef struct wait_entry {
+    u32 core;
+    volatile bool woken;
+    struct wait_entry *next;
+} wait_entry;
+
+typedef struct {
+    spinlock lock;
+    wait_entry *head;
+} wait_queue;
+
+#define WAIT_QUEUE_INIT { SPINLOCK_INIT, NULL }
+
+void wait_queue_init(wait_queue *wq);
+
+void wait_prepare(wait_queue *wq, wait_entry *entry);
+void wait_sleep(wait_entry *entry);
+void wait_finish(wait_queue *wq, wait_entry *entry);
+
+void wait_entry_wake(wait_entry *entry);
+u32 wake_up(wait_queue *wq);
+u32 wake_up_all(wait_queue *wq);
+
+//sleeps until cond holds, cond is re-evaluated after queueing so a wakeup
+//between the first check and the WFI is not lost. With IRQs masked only another
+//core can wake us, drivers keep their polling path for that case.
+#define wait_event(wq, cond) do {                   \
+    while (!(cond)) {                               \
+        wait_entry __wait;                          \
+        wait_prepare((wq), &__wait);                \
+        if (!(cond)) {                              \
+            wait_sleep(&__wait);                    \
+        }                                           \
+        wait_finish((wq), &__wait);                 \
+    }                                               \
+} while (0)
+
+//condition variable, the caller holds lock (plain spin_lock, IRQs on)
+typedef struct {
+    wait_queue wq;
+} condvar;
+
+#define CONDVAR_INIT { WAIT_QUEUE_INIT }
+
+void cond_wait(condvar *cv, spinlock *lock);
+void cond_signal(condvar *cv);
+void cond_broadcast(condvar *cv);
+
+//counting semaphore, count is protected by the queue lock
+typedef struct {
+    wait_queue wq;
+    u32 count;
+} semaphore;
+
+#define SEMAPHORE_INIT(n) { WAIT_QUEUE_INIT, (n) }
+
+void sem_init(semaphore *sem, u32 count);
+void sem_down(semaphore *sem);
+bool sem_try_down(semaphore *sem);
+void sem_up(semaphore *sem);
@@ -17,13 +17,22 @@ void gpio_pin_set_func(u8 pinNumber , GpioFunc func){
 
 }
 
-void gpio_pin_enable(u8 pinNumber){
+//the control signal needs 150 VPU cycles of setup and hold, 1us covers a 250MHz core clock
+#define GPIO_PUD_WAIT_NS 1000
+
+void gpio_pins_enable(u64 pinMask){
     REGS_GPIO->pupd_enable = 0;
-    delay(150);
-    REGS_GPIO->pupd_enable_clocks[pinNumber/32] = 1<<(pinNumber%32);
-    delay(150);
+    ndelay(GPIO_PUD_WAIT_NS);
+    REGS_GPIO->pupd_enable_clocks[0] = (u32)pinMask;
+    REGS_GPIO->pupd_enable_clocks[1] = (u32)(pinMask >> 32);
+    ndelay(GPIO_PUD_WAIT_NS);
     REGS_GPIO->pupd_enable = 0;
-    REGS_GPIO->pupd_enable_clocks[pinNumber/32] = 0;
+    REGS_GPIO->pupd_enable_clocks[0] = 0;
+    REGS_GPIO->pupd_enable_clocks[1] = 0;
+}
+
+void gpio_pin_enable(u8 pinNumber){
+    gpio_pins_enable(1ULL << pinNumber);
 }
 
 void gpio_init(u8 pinNumber,GpioFunc func){
@@ -41,9 +50,7 @@ void gpio_clear(u8 pinNumber){
 }
 
 void delay_seconds(u64 seconds){
-    u64 expo = 10000000;//(10^7)
-    expo = expo * seconds;
-    delay(expo);
+    mdelay(seconds * 1000);
 }
 
 //this a temporary function created to debug 
@@ -56,7 +63,7 @@ void gpio_debug(){
     for (int i = 0 ; i < numPins ; i++){
         gpio_set(output_pins[i]);
     } 
-    delay(5000000);
+    mdelay(500);
 
     for (int i = 0 ; i < numPins ; i++){
         gpio_clear(output_pins[i]);
@@ -67,8 +74,12 @@ void gpio_init_all( GpioFunc func){
     const int output_pins[] = GPIO_PINS;
     size numPins  =( sizeof(output_pins)/sizeof(output_pins[0]));
 
+    u64 pinMask = 0;
+
     for (int i = 0 ; i < numPins ; i++){
         gpio_pin_set_func(output_pins[i],func);
-        gpio_pin_enable(output_pins[i]);
+        pinMask |= 1ULL << output_pins[i];
     }
+
+    gpio_pins_enable(pinMask);
 }
\ No newline at end of file
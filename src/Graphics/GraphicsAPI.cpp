@@ -2,6 +2,7 @@
 #include "Graphics/CGraphics_Interop.hpp"
 #include "libcpp/assert.h"
 #include "libcpp/types.h"
+#include "libcpp/cycle_scope.hpp"
 
 using namespace Graphics;
 
@@ -40,6 +41,7 @@ void Renderer::configure(u32 w, u32 h, u32 bpp) {
 void Renderer::presentFrame() {
     if (!initialized)
         THROW_ERROR("Renderer not initialized");
+    CYCLE_SCOPE("Renderer::presentFrame");
     video_render_frame();
 }
 
@@ -56,6 +58,10 @@ u32 Renderer::getFrameTime() const {
     return video_get_frame_time();
 }
 
+u32 Renderer::getFrameTimeUs() const {
+    return video_get_frame_time_us();
+}
+
 u32 Renderer::getFrameCount() const {
     return video_get_frame_count();
 }
@@ -2,6 +2,7 @@
 #include "Graphics/GraphicsDemo.hpp"
 #include "Graphics/CGraphics_Interop.hpp"
 #include "printf.h"
+#include "libcpp/fmt.hpp"
 #include "libcpp/types.h"
 
 using namespace Graphics;
@@ -49,13 +50,13 @@ static void update_dynamic_ui(Renderer& renderer,
     char buf[128];
 
     // FPS
-    u32 ft = renderer.getFrameTime();
-    u32 computed_fps = (ft == 0) ? 0 : (1000 / ft);
-    sprintf(buf, "FPS: %u", computed_fps);
+    u32 ft = renderer.getFrameTimeUs();
+    u32 computed_fps = (ft == 0) ? 0 : (1000000 / ft);
+    libcpp::format_to<"FPS: {}">(buf, computed_fps);
     fps.setText(buf);
 
     // Frame counter
-    sprintf(buf, "Frame: %d", frame);
+    libcpp::format_to<"Frame: {}">(buf, frame);
     frameCounter.setText(buf);
 
     // Status with semantic colors
@@ -80,19 +81,19 @@ static void update_dynamic_ui(Renderer& renderer,
     for (int i = 0; i < progress_width_chars; ++i)
         progress_text[i] = (i < prog) ? '=' : ' ';
     progress_text[progress_width_chars] = '\0';
-    sprintf(buf, "[%s] %3d%%", progress_text, (prog * 100) / progress_width_chars);
+    libcpp::format_to<"[{}] {:3}%">(buf, progress_text, (prog * 100) / progress_width_chars);
     progressBar.setText(buf);
 
     // Info line (uptime)
-    u32 uptime_s = frame / ((ft == 0) ? 60 : (1000 / ft));
-    sprintf(buf, "Uptime: %us", uptime_s);
+    u32 uptime_s = frame / ((computed_fps == 0) ? 60 : computed_fps);
+    libcpp::format_to<"Uptime: {}s">(buf, uptime_s);
     infoLine.setText(buf);
 
     // Fake resource monitor values
-    sprintf(buf, "CPU Usage: %d%%", (frame * 3) % 100);
+    libcpp::format_to<"CPU Usage: {}%">(buf, (frame * 3) % 100);
     cpuUsage.setText(buf);
 
-    sprintf(buf, "Mem Usage: %d%%", (frame * 7) % 100);
+    libcpp::format_to<"Mem Usage: {}%">(buf, (frame * 7) % 100);
     memUsage.setText(buf);
 
     // Panel title color swap
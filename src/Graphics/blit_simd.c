@@ -0,0 +1,48 @@
+#include "Graphics/blit.h"
+
+//one Q register; only 4-byte aligned so row starts and the backdrop need no fixing up
+typedef u32 u32x4 __attribute__((vector_size(16), aligned(4)));
+
+//64 bytes per iteration, the framebuffer side is brought to 16 bytes first
+void blit_copy32(u32 *dest, const u32 *src, u32 count) {
+    while (count && ((u64)dest & 15)) {
+        *dest++ = *src++;
+        count--;
+    }
+
+    while (count >= 16) {
+        u32x4 a = *(const u32x4 *)(src + 0);
+        u32x4 b = *(const u32x4 *)(src + 4);
+        u32x4 c = *(const u32x4 *)(src + 8);
+        u32x4 d = *(const u32x4 *)(src + 12);
+
+        *(u32x4 *)(dest + 0) = a;
+        *(u32x4 *)(dest + 4) = b;
+        *(u32x4 *)(dest + 8) = c;
+        *(u32x4 *)(dest + 12) = d;
+
+        dest += 16; src += 16; count -= 16;
+    }
+
+    while (count--) *dest++ = *src++;
+}
+
+void blit_fill32(u32 *dest, u32 value, u32 count) {
+    u32x4 v = { value, value, value, value };
+
+    while (count && ((u64)dest & 15)) {
+        *dest++ = value;
+        count--;
+    }
+
+    while (count >= 16) {
+        *(u32x4 *)(dest + 0) = v;
+        *(u32x4 *)(dest + 4) = v;
+        *(u32x4 *)(dest + 8) = v;
+        *(u32x4 *)(dest + 12) = v;
+
+        dest += 16; count -= 16;
+    }
+
+    while (count--) *dest++ = value;
+}
@@ -4,17 +4,22 @@
 #include "Graphics/compositor.h"
 #include "dma.h"
 #include "mm.h"
+#include "smp.h"
+#include "ipi.h"
+#include "percpu.h"
+#include "cycles.h"
+#include "Graphics/blit.h"
+#include "fpsimd.h"
+#include "profiler.h"
+#include "log.h"
+#include "monitor.h"
 #include <stddef.h>
 
 
-
-#define MAX_TEXT_OBJECTS 128
-#define MAX_TEXT_LENGTH 128
-
-
 bool frame_dirty = false;
-u32 frame_count = 0;
-u64 last_frame_time = 0;
+DEFINE_PER_CPU(u32, frame_count);
+u64 last_frame_time = 0;     // us
+u64 last_frame_cycles = 0;
 
 
 
@@ -25,12 +30,25 @@ typedef struct {
     bool visible;
     bool dirty;  // Needs redraw
     u32 id;     // Unique identifier
+    u32 bottom; // Last row touched (exclusive), refreshed when dirty
 } text_object;
 
 static text_object text_objects[MAX_TEXT_OBJECTS];
 static int num_text_objects = 0;
 static u32 next_text_id = 1;
 
+// TILED RENDERING
+// The frame is cut into horizontal tiles that online cores pull from a shared
+// counter; each tile is cleared and rasterised by exactly one core.
+
+#define RENDER_TILE_HEIGHT 32
+
+static u32 render_cores = NUM_CORES;
+static u32 next_tile __cacheline_aligned = 0;
+static u32 num_tiles = 0;
+static smp_barrier render_barrier __cacheline_aligned;
+static DEFINE_PER_CPU(u32, tiles_rendered);
+
 // FRAME BUFFER MANAGEMENT
 
 // static u32 frame_count = 0;
@@ -163,13 +181,107 @@ void video_clear_all_text() {
 
 
 
+static void clear_rows(u32 y0, u32 y1) {
+    u32 offset = y0 * fb_req.pitch.pitch;
+    u32 *dest = (u32 *)(DRAWBUFFER + offset);
+    u32 *src = (fb_req.depth.bpp == 32) ? bg32_buffer : bg8_buffer;
+    u32 count = ((y1 - y0) * fb_req.pitch.pitch) / 4;
+
+    blit_copy32(dest, src + offset / 4, count);
+}
+
+//the other cores run this from the IPI call softirq: interrupts still get in, but
+//other bottom halves on that core wait for the frame, so nothing in here may sleep
+static void render_tiles(void *arg) {
+    CYCLE_SCOPE("render_tiles");
+    u32 tile;
+
+    while ((tile = __atomic_fetch_add(&next_tile, 1, __ATOMIC_RELAXED)) < num_tiles) {
+        u32 y0 = tile * RENDER_TILE_HEIGHT;
+        u32 y1 = y0 + RENDER_TILE_HEIGHT;
+
+        if (y1 > fb_req.res.yres) y1 = fb_req.res.yres;
+
+        clear_rows(y0, y1);
+        this_cpu(tiles_rendered)++;
+
+        for (int i = 0; i < num_text_objects; i++) {
+            text_object *obj = &text_objects[i];
+
+            if (obj->visible && obj->y < y1 && obj->bottom > y0) {
+                video_draw_string_clipped(obj->text, obj->x, obj->y, obj->color, BACK_COLOR, y0, y1);
+            }
+        }
+    }
+
+    //pixels must have reached memory before core 0 kicks the DMA
+    asm volatile("dsb sy");
+    smp_barrier_wait(&render_barrier);
+}
+
+static void render_frame_tiled(u32 core_mask, u32 cores) {
+    for (int i = 0; i < num_text_objects; i++) {
+        text_object *obj = &text_objects[i];
+
+        if (obj->dirty) {
+            obj->bottom = video_string_bottom(obj->text, obj->x, obj->y);
+            obj->dirty = false;
+        }
+    }
+
+    num_tiles = (fb_req.res.yres + RENDER_TILE_HEIGHT - 1) / RENDER_TILE_HEIGHT;
+    next_tile = 0;
+
+    //only when the count changes, a core can still be waiting out the last frame
+    if (render_barrier.cores != cores) {
+        smp_barrier_init(&render_barrier, cores);
+    }
+
+    ipi_call(core_mask & ~(1 << cpu_id()), render_tiles, NULL, false);
+    render_tiles(NULL);
+}
+
+// Limit the cores used for rendering (1 = serial path)
+void video_set_render_cores(u32 cores) {
+    render_cores = (cores == 0) ? 1 : cores;
+}
+
+u32 video_get_render_cores() {
+    return render_cores;
+}
+
 // OPTIMIZED FRAME RENDERING
 void video_render_frame() {
     if (!frame_dirty){
-        printf("Skipping Frame Render");
+        log_debug("Skipping Frame Render\n");
         return;
     }  // Skip if nothing changed
-    u64 ms_start = timer_get_ticks() / 1000;
+    CYCLE_SCOPE("video_render_frame");
+    u64 frame_start = cycles_now();
+
+    u32 core_mask = 0;
+    u32 cores = 0;
+
+    for (u32 core = 0; core < NUM_CORES && cores < render_cores; core++) {
+        if (cpu_is_online(core)) {
+            core_mask |= 1 << core;
+            cores++;
+        }
+    }
+
+    if (cores > 1 && (fb_req.depth.bpp == 32 || fb_req.depth.bpp == 8)) {
+        render_frame_tiled(core_mask, cores);
+
+        if (use_dma) {
+            video_dma();
+        }
+
+        frame_dirty = false;
+        this_cpu(frame_count)++;
+        last_frame_cycles = cycles_now() - frame_start;
+        last_frame_time = cycles_to_ns(last_frame_cycles) / 1000;
+        return;
+    }
     
     // Clear background (keeping your optimization)
     if (fb_req.depth.bpp == 32) {
@@ -208,7 +320,10 @@ void video_render_frame() {
         text_object *obj = &text_objects[i];
         if (obj->visible) {
             video_draw_string_colored(obj->text, obj->x, obj->y, obj->color, BACK_COLOR);
-            obj->dirty = false;
+            if (obj->dirty) {
+                obj->bottom = video_string_bottom(obj->text, obj->x, obj->y);
+                obj->dirty = false;
+            }
             // printf("Text object is Rendering");
         }
     }
@@ -220,17 +335,32 @@ void video_render_frame() {
     }
     
     frame_dirty = false;
-    frame_count++;
-    last_frame_time = timer_get_ticks() / 1000 - ms_start;
+    this_cpu(frame_count)++;
+    last_frame_cycles = cycles_now() - frame_start;
+    last_frame_time = cycles_to_ns(last_frame_cycles) / 1000;
 }
 
-// Get frame timing info
+// Get frame timing info (ms, kept for existing callers)
 u32 video_get_frame_time() {
+    return (u32)(last_frame_time / 1000);
+}
+
+u32 video_get_frame_time_us() {
     return (u32)last_frame_time;
 }
 
+u64 video_get_frame_cycles() {
+    return last_frame_cycles;
+}
+
 u32 video_get_frame_count() {
-    return frame_count;
+    u32 total = 0;
+
+    for (u32 core = 0; core < NUM_CORES; core++) {
+        total += per_cpu(frame_count, core);
+    }
+
+    return total;
 }
 
 // Force next frame to redraw (useful for animations)
@@ -244,6 +374,8 @@ void demo_usage() {
     video_init();
     video_set_resolution(800, 600, 32);
 
+    render_scaling_test(512, 20);
+
     // Static labels
     u32 title_id      = video_add_text("My Operating System v1.0", 10, 10,  0xFFFFFFFF);
     u32 status_id     = video_add_text("Status: Running",          10, 40,  0xFF00FF00);
@@ -264,29 +396,29 @@ void demo_usage() {
         char buffer[128];
 
         // FPS
-        u32 frame_time = video_get_frame_time();
-        u32 fps = (frame_time > 0) ? (1000 / frame_time) : 0;
-        sprintf(buffer, "FPS: %d", fps);
+        u32 frame_time = video_get_frame_time_us();
+        u32 fps = (frame_time > 0) ? (1000000 / frame_time) : 0;
+        snprintf(buffer, sizeof(buffer), "FPS: %d", fps);
         video_update_text(fps_id, buffer);
 
         // Frame counter
-        sprintf(buffer, "Frame: %d", frame);
+        snprintf(buffer, sizeof(buffer), "Frame: %d", frame);
         video_update_text(frame_id, buffer);
 
         // Frame time
-        sprintf(buffer, "Frame Time: %d ms", frame_time);
+        snprintf(buffer, sizeof(buffer), "Frame Time: %d us", frame_time);
         video_update_text(frametime_id, buffer);
 
         // Total frames rendered
-        sprintf(buffer, "Total Frames: %d", video_get_frame_count());
+        snprintf(buffer, sizeof(buffer), "Total Frames: %d", video_get_frame_count());
         video_update_text(total_id, buffer);
 
         // Text object count
-        sprintf(buffer, "Objects: %d", num_text_objects);
+        snprintf(buffer, sizeof(buffer), "Objects: %d", num_text_objects);
         video_update_text(objects_id, buffer);
 
         // DMA status
-        sprintf(buffer, "DMA: %s", use_dma ? "ON" : "OFF");
+        snprintf(buffer, sizeof(buffer), "DMA: %s", use_dma ? "ON" : "OFF");
         video_update_text(dma_id, buffer);
 
         // Animated moving text
@@ -301,5 +433,54 @@ void demo_usage() {
 
         // Render frame
         video_render_frame();
+
+        // Monitor commands run between frames, where cores/dma can switch safely
+        monitor_poll();
+    }
+}
+
+// Frame time for a crowded scene on 1..N cores
+void render_scaling_test(u32 num_objects, u32 frames) {
+    char buffer[32];
+
+    video_clear_all_text();
+
+    for (u32 i = 0; i < num_objects && i < MAX_TEXT_OBJECTS; i++) {
+        snprintf(buffer, sizeof(buffer), "Object %d", i);
+        video_add_text(buffer, 10 + (i % 6) * 130, 10 + (i / 6) * 12 % 580, 0xFFFFFFFF);
+    }
+
+    printf("Render scaling: %d objects, %d frames\n", num_text_objects, frames);
+    prof_start(4000, PROF_MAX_DEPTH);
+
+    for (u32 cores = 1; cores <= NUM_CORES; cores++) {
+        video_set_render_cores(cores);
+
+        for (u32 core = 0; core < NUM_CORES; core++) {
+            per_cpu(tiles_rendered, core) = 0;
+        }
+        cycle_report_reset();
+
+        u64 start = timer_get_ticks();
+
+        for (u32 f = 0; f < frames; f++) {
+            video_mark_dirty();
+            video_render_frame();
+        }
+
+        u64 per_frame = (timer_get_ticks() - start) / frames;
+        printf("\t%d core(s): %d us/frame, tiles", cores, (u32)per_frame);
+
+        for (u32 core = 0; core < NUM_CORES; core++) {
+            printf(" %d", per_cpu(tiles_rendered, core));
+        }
+        printf("\n");
+        cycle_report();
     }
+
+    fpsimd_report();
+    prof_stop();
+    prof_dump("render");
+    video_set_render_cores(NUM_CORES);
+    video_clear_all_text();
 }
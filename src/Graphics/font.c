@@ -56,17 +56,31 @@ void init_glyph_cache() {
 
 
 void video_draw_char_colored(char c, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color) {
+    video_draw_char_clipped(c, pos_x, pos_y, text_color, bg_color, 0, fb_req.res.yres);
+}
+
+// Only rows in [clip_y0, clip_y1) are touched, so render tiles never overlap.
+void video_draw_char_clipped(char c, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color,
+                             u32 clip_y0, u32 clip_y1) {
     if (!cache_initialized) return;
     if (pos_x + font_get_width() > fb_req.res.xres || 
         pos_y + font_get_height() > fb_req.res.yres) return;
     
     unsigned char uc = (unsigned char)c;
     if (uc >= MAX_CHARS) uc = '?';
+
+    u32 y_start = pos_y < clip_y0 ? clip_y0 - pos_y : 0;
+    u32 y_end = font_get_height();
+
+    if (pos_y + y_end > clip_y1) {
+        if (pos_y >= clip_y1) return;
+        y_end = clip_y1 - pos_y;
+    }
     
     if (fb_req.depth.bpp == 32) {
         u32 pitch_words = fb_req.pitch.pitch >> 2;
         
-        for (int y = 0; y < font_get_height(); y++) {
+        for (int y = y_start; y < y_end; y++) {
             u32 *dest = (u32 *)DRAWBUFFER + (pos_y + y) * pitch_words + pos_x;
             
             for (int x = 0; x < font_get_width(); x++) {
@@ -75,7 +89,7 @@ void video_draw_char_colored(char c, u32 pos_x, u32 pos_y, u32 text_color, u32 b
             }
         }
     } else if (fb_req.depth.bpp == 8) {
-        for (int y = 0; y < font_get_height(); y++) {
+        for (int y = y_start; y < y_end; y++) {
             u8 *dest = (u8 *)DRAWBUFFER + (pos_y + y) * fb_req.pitch.pitch + pos_x;
             
             for (int x = 0; x < font_get_width(); x++) {
@@ -87,12 +101,22 @@ void video_draw_char_colored(char c, u32 pos_x, u32 pos_y, u32 text_color, u32 b
 }
 
 void video_draw_string_colored(char *s, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color) {
+    video_draw_string_clipped(s, pos_x, pos_y, text_color, bg_color, 0, fb_req.res.yres);
+}
+
+void video_draw_string_clipped(char *s, u32 pos_x, u32 pos_y, u32 text_color, u32 bg_color,
+                               u32 clip_y0, u32 clip_y1) {
     u32 x = pos_x;
     int len = 0;
     while (s[len]) len++;
     
     for (int i = 0; i < len; i++) {
-        video_draw_char_colored(s[i], x, pos_y, text_color, bg_color);
+        //text only wraps downwards
+        if (pos_y >= clip_y1) break;
+
+        if (pos_y + font_get_height() > clip_y0) {
+            video_draw_char_clipped(s[i], x, pos_y, text_color, bg_color, clip_y0, clip_y1);
+        }
         x += font_get_width() + 2;
         
         if (x + font_get_width() >= fb_req.res.xres) {
@@ -102,6 +126,24 @@ void video_draw_string_colored(char *s, u32 pos_x, u32 pos_y, u32 text_color, u3
     }
 }
 
+// Bottom row (exclusive) reached by a string, following the wrap rules above.
+u32 video_string_bottom(char *s, u32 pos_x, u32 pos_y) {
+    u32 x = pos_x;
+    u32 bottom = pos_y + font_get_height();
+
+    for (int i = 0; s[i]; i++) {
+        bottom = pos_y + font_get_height();
+        x += font_get_width() + 2;
+
+        if (x + font_get_width() >= fb_req.res.xres) {
+            x = pos_x;
+            pos_y += font_get_height() + 2;
+        }
+    }
+
+    return bottom;
+}
+
 
 void video_draw_char(char c, u32 pos_x, u32 pos_y) {
     if (!cache_initialized) return;
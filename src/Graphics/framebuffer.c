@@ -8,6 +8,7 @@
 #include <stddef.h>
 #include "Graphics/font.h"
 #include "Graphics/compositor.h"
+#include "Graphics/blit.h"
 
 
 mailbox_fb_request fb_req;
@@ -54,6 +55,10 @@ void video_set_dma(bool b) {
     use_dma = b;
 }
 
+bool video_get_dma() {
+    return use_dma;
+}
+
 void do_dma(void *dest, void *src, u32 total) {
     // Optimized: Use larger chunks and fewer DMA operations
     const u32 max_chunk = 0x3FFFFF; // Even larger chunks
@@ -80,15 +85,9 @@ void clear_screen_once() {
     if (screen_initialized) return;
     
     if (fb_req.depth.bpp == 32) {
-        u32 *buff = (u32 *)DRAWBUFFER;
-        for (int i = 0; i < fb_req.buff.screen_size / 4; i++) {
-            buff[i] = BACK_COLOR;
-        }
+        blit_fill32((u32 *)DRAWBUFFER, BACK_COLOR, fb_req.buff.screen_size / 4);
     } else if (fb_req.depth.bpp == 8) {
-        u32 *buff = (u32 *)DRAWBUFFER;
-        for (int i = 0; i < fb_req.buff.screen_size / 4; i++) {
-            buff[i] = 0x01010101;
-        }
+        blit_fill32((u32 *)DRAWBUFFER, 0x01010101, fb_req.buff.screen_size / 4);
     }
     
     screen_initialized = true;
@@ -91,7 +91,7 @@ void MiniUart::printf(const char* format, ...) {
     
     va_list args;
     va_start(args, format);
-    tfp_format(this, uart_putc_callback, (char*)format, args);
+    tfp_format(this, uart_putc_callback, format, args);
     va_end(args);
 }
 
@@ -101,7 +101,27 @@ void MiniUart::vprintf(const char* format, va_list args) {
     }
     
     // Use tinyprintf vprintf variant
-     tfp_format(this, uart_putc_callback, (char*)format, args);
+     tfp_format(this, uart_putc_callback, format, args);
+}
+
+void MiniUart::write(const char* buf, u32 len) {
+    if (!initialized) {
+        THROW_ERROR("MiniUart not initialized!");
+    }
+
+    const u8* bytes = reinterpret_cast<const u8*>(buf);
+    u32 start = 0;
+
+    // through the console, which may be the PL011 rather than this UART
+    for (u32 i = 0; i < len; i++) {
+        if (buf[i] == '\n') {
+            console_write_all(bytes + start, i - start);
+            console_write_all(reinterpret_cast<const u8*>("\r\n"), 2);
+            start = i + 1;
+        }
+    }
+
+    console_write_all(bytes + start, len - start);
 }
 
 bool MiniUart::tryRecv(char& c) {
@@ -115,7 +135,8 @@ bool MiniUart::tryRecv(char& c) {
 }
 
 size_t MiniUart::available() const {
-    return isReadable() ? 1 : 0;
+    if (!initialized) return 0;
+    return uart_available();
 }
 
 // Singleton
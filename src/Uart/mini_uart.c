@@ -2,9 +2,27 @@
 #include "utils.h"
 #include "peripherals/aux.h"
 #include "Uart/mini_uart.h"
+#include "ring_buffer.h"
+#include "irq.h"
+#include "wait.h"
+#include "spinlock.h"
 
 int  init = 0;
 
+static void handle_uart_irq(u32 irq, void *ctx);
+
+//filled by the AUX IRQ (core 0), drained by uart_recv/uart_read
+static spsc_ring *rx_ring = NULL;
+static u32 rx_dropped = 0;
+static wait_queue rx_wq = WAIT_QUEUE_INIT;
+
+//every core prints, so both ends of the TX ring are taken under tx_lock
+static spsc_ring *tx_ring = NULL;
+static spinlock tx_lock = SPINLOCK_INIT;
+
+//asked for more output whenever the TX interrupt finds the ring empty
+static void (*tx_refill)() = NULL;
+
 void uart_init() {
     if(init){
         return;
@@ -12,12 +30,14 @@ void uart_init() {
     gpio_pin_set_func(TXD, GFAlt5);
     gpio_pin_set_func(RXD, GFAlt5);
 
-    gpio_pin_enable(TXD);
-    gpio_pin_enable(RXD);
+    gpio_pins_enable((1ULL << TXD) | (1ULL << RXD));
+
+    rx_ring = spsc_ring_create();
+    tx_ring = spsc_ring_create();
 
     REGS_AUX->enables = 1;
     REGS_AUX->mu_control = 0;
-    REGS_AUX->mu_ier = 0xD;
+    REGS_AUX->mu_ier = MU_IER_RX;
     REGS_AUX->mu_lcr = 3;
     REGS_AUX->mu_mcr = 0;
 
@@ -31,6 +51,8 @@ void uart_init() {
 
     REGS_AUX->mu_control = 3;
 
+    irq_register(IRQ_AUX, handle_uart_irq, NULL);
+
     uart_send('\r');
     uart_send('\n');
     uart_send('\n');
@@ -38,16 +60,139 @@ void uart_init() {
     init = 1;
 }
 
+//moves queued bytes into the FIFO, the TX interrupt stays on while anything is left
+static void uart_tx_fill() {
+    u8 c;
+
+    while((REGS_AUX->mu_lsr & MU_LSR_TX_EMPTY) && spsc_ring_pop(tx_ring, &c)) {
+        REGS_AUX->mu_io = c;
+    }
+
+    REGS_AUX->mu_ier = spsc_ring_count(tx_ring) ? MU_IER_RX | MU_IER_TX : MU_IER_RX;
+}
+
 void uart_send(char c) {
-    while(!(REGS_AUX->mu_lsr & 0x20));
+    //before uart_init there is no ring, write straight to the FIFO
+    if (!tx_ring) {
+        while(!(REGS_AUX->mu_lsr & MU_LSR_TX_EMPTY));
+
+        REGS_AUX->mu_io = c;
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+
+    //ring full: make room by polling rather than waiting on an IRQ that may be masked
+    while(!spsc_ring_push(tx_ring, c)) {
+        uart_tx_fill();
+    }
+
+    uart_tx_fill();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+//queues what fits and returns the count, never blocks
+u32 uart_write(const u8 *buf, u32 len) {
+    if (!tx_ring) {
+        return 0;
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+    u32 written = spsc_ring_write(tx_ring, buf, len);
+
+    uart_tx_fill();
+    spin_unlock_irqrestore(&tx_lock, flags);
+
+    return written;
+}
+
+//copies out whatever has been received, up to len, never blocks
+u32 uart_read(u8 *buf, u32 len) {
+    if (!rx_ring) {
+        return 0;
+    }
+
+    if (irq_disabled()) {
+        uart_rx_poll();
+    }
+
+    return spsc_ring_read(rx_ring, buf, len);
+}
 
-    REGS_AUX->mu_io = c;
+u32 uart_available() {
+    return rx_ring ? spsc_ring_count(rx_ring) : 0;
+}
+
+u32 uart_tx_free() {
+    return tx_ring ? SPSC_RING_SIZE - spsc_ring_count(tx_ring) : 0;
+}
+
+void uart_set_tx_refill(void (*refill)()) {
+    tx_refill = refill;
+}
+
+//the TX interrupt is level triggered on an empty FIFO, turning it on is enough
+//to get an idle transmitter into tx_refill
+void uart_tx_kick() {
+    if (!tx_ring) {
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+    REGS_AUX->mu_ier = MU_IER_RX | MU_IER_TX;
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+//ring producer: runs from the AUX IRQ, or from uart_recv while IRQs are masked
+void uart_rx_poll() {
+    bool received = false;
+
+    while(REGS_AUX->mu_lsr & MU_LSR_DATA_READY) {
+        u8 c = REGS_AUX->mu_io & 0xFF;
+
+        if (!spsc_ring_push(rx_ring, c)) {
+            rx_dropped++;
+        }
+        received = true;
+    }
+
+    if (received) {
+        wake_up(&rx_wq);
+    }
+}
+
+//only queue the bytes here, kernel_main echoes them
+static void handle_uart_irq(u32 irq, void *ctx) {
+    uart_rx_poll();
+
+    spin_lock(&tx_lock);
+    uart_tx_fill();
+    bool idle = spsc_ring_count(tx_ring) == 0;
+    spin_unlock(&tx_lock);
+
+    //the refill queues through uart_write, which takes tx_lock itself
+    if (idle && tx_refill) {
+        tx_refill();
+    }
+}
+
+u32 uart_rx_dropped() {
+    return rx_dropped;
 }
 
 char uart_recv() {
-    while(!(REGS_AUX->mu_lsr & 1));
+    u8 c;
+
+    while(!spsc_ring_pop(rx_ring, &c)) {
+        //nobody else will drain the FIFO with interrupts off
+        if (irq_disabled()) {
+            uart_rx_poll();
+        } else {
+            wait_event(&rx_wq, spsc_ring_count(rx_ring) != 0);
+        }
+    }
 
-    return REGS_AUX->mu_io & 0xFF;
+    return c;
 }
 
 void uart_send_string(char *str) {
@@ -62,14 +207,25 @@ void uart_send_string(char *str) {
 }
 
 bool uart_is_readable() {
-    return (REGS_AUX->mu_lsr & 1) != 0;
+    return spsc_ring_count(rx_ring) != 0 || (REGS_AUX->mu_lsr & MU_LSR_DATA_READY) != 0;
 }
 
 bool uart_is_writable() {
-    return (REGS_AUX->mu_lsr & 0x20) != 0;
+    return spsc_ring_count(tx_ring) < SPSC_RING_SIZE;
 }
 
+//drains the ring by polling, so it also works from panic() with IRQs masked
 void uart_flush() {
+    if (tx_ring) {
+        u64 flags = spin_lock_irqsave(&tx_lock);
+
+        while(spsc_ring_count(tx_ring)) {
+            uart_tx_fill();
+        }
+
+        spin_unlock_irqrestore(&tx_lock, flags);
+    }
+
     // Wait for transmitter to finish
-    while(!(REGS_AUX->mu_lsr & 0x40));
-}
\ No newline at end of file
+    while(!(REGS_AUX->mu_lsr & MU_LSR_TX_IDLE));
+}
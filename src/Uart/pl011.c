@@ -0,0 +1,362 @@
+#include "Gpio/gpio.h"
+#include "peripherals/aux.h"
+#include "Uart/pl011.h"
+#include "Uart/mini_uart.h"
+#include "ring_buffer.h"
+#include "mailbox.h"
+#include "mem.h"
+#include "dma.h"
+#include "irq.h"
+#include "wait.h"
+#include "spinlock.h"
+
+static void handle_pl011_irq(u32 irq, void *ctx);
+static void pl011_dma_done(dma_channel *channel, void *ctx);
+static void pl011_dma_finish();
+
+static u32 baud_rate = 0;
+
+//console.h, with PL011_CONSOLE set
+bool console_pl011 = false;
+
+//filled by the UART IRQ (core 0), drained by pl011_recv/pl011_read
+static spsc_ring *rx_ring = NULL;
+static u32 rx_dropped = 0;
+static wait_queue rx_wq = WAIT_QUEUE_INIT;
+
+//every core prints, so both ends of the TX ring are taken under tx_lock
+static spsc_ring *tx_ring = NULL;
+static spinlock tx_lock = SPINLOCK_INIT;
+
+//asked for more output whenever the TX interrupt finds the ring empty
+static void (*tx_refill)() = NULL;
+
+typedef enum {
+    TX_DMA_IDLE,
+    TX_DMA_FILLING,     //claimed by a writer copying into tx_dma_buf
+    TX_DMA_PENDING,     //queued behind bytes already in tx_ring
+    TX_DMA_ACTIVE       //owns the FIFO, tx_ring waits for the completion
+} tx_dma_state;
+
+static dma_channel *tx_dma = NULL;
+static u32 *tx_dma_buf = NULL;     //one byte per word, the DMA engine only does 32-bit writes to DR
+static u32 tx_dma_len = 0;
+static volatile tx_dma_state tx_dma_busy = TX_DMA_IDLE;
+
+bool pl011_init(u32 baud) {
+    u32 clock = mailbox_clock_rate(CT_UART);
+
+    if (!baud || baud > PL011_MAX_BAUD || baud * 16 > clock) {
+        return false;
+    }
+
+    REGS_UART->u_cr = 0;
+    while(REGS_UART->u_fr & UART_FR_BUSY);
+
+    gpio_pin_set_func(TXD, GFAlt0);
+    gpio_pin_set_func(RXD, GFAlt0);
+
+    gpio_pins_enable((1ULL << TXD) | (1ULL << RXD));
+
+    if (!rx_ring) {
+        rx_ring = spsc_ring_create();
+        tx_ring = spsc_ring_create();
+    }
+
+    //divisor = clock / (16 * baud), the fraction kept in 1/64ths and rounded
+    u32 div = (u32)(((u64)clock * 4 + baud / 2) / baud);
+
+    REGS_UART->u_icr = UART_INT_ALL;
+    REGS_UART->u_ibrd = div >> 6;
+    REGS_UART->u_fbrd = div & 0x3F;
+    REGS_UART->u_lcrh = UART_LCRH_WLEN8 | UART_LCRH_FEN;
+
+    //RX interrupt at 8 entries plus the timeout for the tail, TX refilled once down to 4
+    REGS_UART->u_ifls = UART_IFLS_RX(2) | UART_IFLS_TX(1);
+    REGS_UART->u_imsc = UART_INT_RX | UART_INT_RT;
+    REGS_UART->u_dmacr = 0;
+
+    REGS_UART->u_cr = UART_CR_UARTEN | UART_CR_TXE | UART_CR_RXE;
+
+    baud_rate = (u32)((u64)clock * 4 / div);
+
+    irq_register(IRQ_UART, handle_pl011_irq, NULL);
+
+    pl011_send('\r');
+    pl011_send('\n');
+    pl011_send('\n');
+
+    return true;
+}
+
+//the rate actually produced by the divisor
+u32 pl011_baud() {
+    return baud_rate;
+}
+
+static void pl011_dma_start() {
+    dma_setup_dev_write(tx_dma, UART_DR_BUS_ADDR, tx_dma_buf, tx_dma_len * 4, DREQ_UART_TX);
+
+    tx_dma_busy = TX_DMA_ACTIVE;
+    REGS_UART->u_dmacr = UART_DMACR_TXDMAE;
+    dma_start(tx_dma);
+}
+
+//moves queued bytes into the FIFO, the TX interrupt stays on while anything is left
+static void pl011_tx_fill() {
+    u8 c;
+
+    if (tx_dma_busy == TX_DMA_ACTIVE) {
+        REGS_UART->u_imsc &= ~UART_INT_TX;
+        return;
+    }
+
+    while(!(REGS_UART->u_fr & UART_FR_TXFF) && spsc_ring_pop(tx_ring, &c)) {
+        REGS_UART->u_dr = c;
+    }
+
+    if (spsc_ring_count(tx_ring)) {
+        REGS_UART->u_imsc |= UART_INT_TX;
+        return;
+    }
+
+    REGS_UART->u_imsc &= ~UART_INT_TX;
+
+    if (tx_dma_busy == TX_DMA_PENDING) {
+        pl011_dma_start();
+    }
+}
+
+//tx_lock held: ends a transfer the engine has finished. Also checked on the DMA
+//completion, which can arrive late, after a newer transfer has been started
+static void pl011_dma_poll() {
+    if (tx_dma_busy == TX_DMA_ACTIVE && !(REGS_DMA(tx_dma->channel)->control & CS_ACTIVE)) {
+        pl011_dma_finish();
+    }
+}
+
+void pl011_send(char c) {
+    //before pl011_init there is no ring, write straight to the FIFO
+    if (!tx_ring) {
+        while(REGS_UART->u_fr & UART_FR_TXFF);
+
+        REGS_UART->u_dr = c;
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+
+    //ring full: make room by polling rather than waiting on an IRQ that may be masked,
+    //the DMA completion included since pl011_dma_done needs the lock we hold
+    while(!spsc_ring_push(tx_ring, c)) {
+        pl011_dma_poll();
+        pl011_tx_fill();
+    }
+
+    pl011_tx_fill();
+    spin_unlock_irqrestore(&tx_lock, flags);
+}
+
+//queues what fits and returns the count, never blocks
+u32 pl011_write(const u8 *buf, u32 len) {
+    if (!tx_ring) {
+        return 0;
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+    u32 written = spsc_ring_write(tx_ring, buf, len);
+
+    pl011_tx_fill();
+    spin_unlock_irqrestore(&tx_lock, flags);
+
+    return written;
+}
+
+//hands up to PL011_DMA_MAX bytes to the DMA engine, paced by the TX DREQ.
+//Returns the count taken, 0 while the previous transfer is still going
+u32 pl011_write_dma(const u8 *buf, u32 len) {
+    tx_dma_state idle = TX_DMA_IDLE;
+
+    if (!__atomic_compare_exchange_n(&tx_dma_busy, &idle, TX_DMA_FILLING, false,
+            __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+
+    if (!tx_dma) {
+        tx_dma_buf = allocate_memory(PL011_DMA_MAX * sizeof(u32));
+        tx_dma = dma_open_channel(CT_NORMAL);
+        dma_set_callback(tx_dma, pl011_dma_done, NULL);
+    }
+
+    if (len > PL011_DMA_MAX) {
+        len = PL011_DMA_MAX;
+    }
+
+    for (u32 i=0; i<len; i++) {
+        tx_dma_buf[i] = buf[i];
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+
+    tx_dma_len = len;
+    tx_dma_busy = TX_DMA_PENDING;
+    pl011_tx_fill();
+
+    spin_unlock_irqrestore(&tx_lock, flags);
+
+    return len;
+}
+
+bool pl011_dma_busy() {
+    return tx_dma_busy != TX_DMA_IDLE;
+}
+
+//tx_lock held: give the FIFO back to tx_ring
+static void pl011_dma_finish() {
+    REGS_UART->u_dmacr = 0;
+    tx_dma_busy = TX_DMA_IDLE;
+    pl011_tx_fill();
+}
+
+static void pl011_dma_done(dma_channel *channel, void *ctx) {
+    spin_lock(&tx_lock);
+    pl011_dma_poll();
+    bool idle = spsc_ring_count(tx_ring) == 0 && tx_dma_busy == TX_DMA_IDLE;
+    spin_unlock(&tx_lock);
+
+    //the UART IRQ only asks for more once the ring drains, nothing was in it
+    if (idle && tx_refill) {
+        tx_refill();
+    }
+}
+
+//ring producer: runs from the UART IRQ, or from pl011_recv while IRQs are masked
+void pl011_rx_poll() {
+    bool received = false;
+
+    while(!(REGS_UART->u_fr & UART_FR_RXFE)) {
+        u8 c = REGS_UART->u_dr & 0xFF;
+
+        if (!spsc_ring_push(rx_ring, c)) {
+            rx_dropped++;
+        }
+        received = true;
+    }
+
+    if (received) {
+        wake_up(&rx_wq);
+    }
+}
+
+static void handle_pl011_irq(u32 irq, void *ctx) {
+    u32 mis = REGS_UART->u_mis;
+
+    REGS_UART->u_icr = mis;
+
+    if (mis & UART_INT_OE) {
+        rx_dropped++;
+    }
+
+    pl011_rx_poll();
+
+    spin_lock(&tx_lock);
+    pl011_tx_fill();
+    bool idle = spsc_ring_count(tx_ring) == 0 && tx_dma_busy == TX_DMA_IDLE;
+    spin_unlock(&tx_lock);
+
+    //the refill queues through pl011_write, which takes tx_lock itself
+    if (idle && tx_refill) {
+        tx_refill();
+    }
+}
+
+u32 pl011_rx_dropped() {
+    return rx_dropped;
+}
+
+char pl011_recv() {
+    u8 c;
+
+    while(!spsc_ring_pop(rx_ring, &c)) {
+        //nobody else will drain the FIFO with interrupts off
+        if (irq_disabled()) {
+            pl011_rx_poll();
+        } else {
+            wait_event(&rx_wq, spsc_ring_count(rx_ring) != 0);
+        }
+    }
+
+    return c;
+}
+
+//copies out whatever has been received, up to len, never blocks
+u32 pl011_read(u8 *buf, u32 len) {
+    if (irq_disabled()) {
+        pl011_rx_poll();
+    }
+
+    return spsc_ring_read(rx_ring, buf, len);
+}
+
+u32 pl011_available() {
+    return rx_ring ? spsc_ring_count(rx_ring) : 0;
+}
+
+u32 pl011_tx_free() {
+    return tx_ring ? SPSC_RING_SIZE - spsc_ring_count(tx_ring) : 0;
+}
+
+void pl011_set_tx_refill(void (*refill)()) {
+    tx_refill = refill;
+}
+
+//the TX interrupt only fires when the FIFO level crosses the threshold, so an idle
+//transmitter never raises one: run the refill here instead
+void pl011_tx_kick() {
+    if (!tx_ring || !tx_refill) {
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&tx_lock);
+    bool idle = spsc_ring_count(tx_ring) == 0 && tx_dma_busy == TX_DMA_IDLE;
+    spin_unlock_irqrestore(&tx_lock, flags);
+
+    if (idle) {
+        tx_refill();
+    }
+}
+
+void pl011_send_string(char *str) {
+    while(*str) {
+        if (*str == '\n') {
+            pl011_send('\r');
+        }
+
+        pl011_send(*str);
+        str++;
+    }
+}
+
+bool pl011_is_readable() {
+    return spsc_ring_count(rx_ring) != 0 || !(REGS_UART->u_fr & UART_FR_RXFE);
+}
+
+bool pl011_is_writable() {
+    return spsc_ring_count(tx_ring) < SPSC_RING_SIZE;
+}
+
+//drains the ring and any DMA transfer by polling, so it also works from panic() with IRQs masked
+void pl011_flush() {
+    if (tx_ring) {
+        u64 flags = spin_lock_irqsave(&tx_lock);
+
+        while(spsc_ring_count(tx_ring) || tx_dma_busy >= TX_DMA_PENDING) {
+            pl011_dma_poll();
+            pl011_tx_fill();
+        }
+
+        spin_unlock_irqrestore(&tx_lock, flags);
+    }
+
+    while(!(REGS_UART->u_fr & UART_FR_TXFE) || (REGS_UART->u_fr & UART_FR_BUSY));
+}
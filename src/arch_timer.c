@@ -0,0 +1,143 @@
+#include "arch_timer.h"
+#include "percpu.h"
+#include "smp.h"
+#include "ipi.h"
+#include "timer.h"
+#include "printf.h"
+#include "irq.h"
+#include "peripherals/local.h"
+
+typedef struct {
+    arch_timer_fn fn;
+    void *arg;
+} arch_timer_slot;
+
+static DEFINE_PER_CPU(arch_timer_slot, arch_timers[2]);
+
+static void handle_arch_timer(u32 irq, void *ctx);
+
+static void arch_timer_write_ctl(u32 timer, u64 ctl) {
+    if (timer == ARCH_TIMER_VIRT) {
+        asm volatile("msr cntv_ctl_el0, %0; isb" : : "r"(ctl));
+    } else {
+        asm volatile("msr cntp_ctl_el0, %0; isb" : : "r"(ctl));
+    }
+}
+
+static void arch_timer_write_cval(u32 timer, u64 cval) {
+    if (timer == ARCH_TIMER_VIRT) {
+        asm volatile("msr cntv_cval_el0, %0" : : "r"(cval));
+    } else {
+        asm volatile("msr cntp_cval_el0, %0" : : "r"(cval));
+    }
+}
+
+//routes this core's CNTV and CNTPNS to its IRQ line, both timers start disabled
+void arch_timer_init_core() {
+    u32 core = cpu_id();
+
+    arch_timer_write_ctl(ARCH_TIMER_VIRT, 0);
+    arch_timer_write_ctl(ARCH_TIMER_PHYS, 0);
+
+    REGS_LOCAL->core_timer_int_ctrl[core] |= LOCAL_IRQ_CNTV | LOCAL_IRQ_CNTPNS;
+}
+
+//core 0, before anything reads the counter
+void arch_timer_init() {
+    //crystal source, increment by 1: the 2837 counter does not run until the prescaler is set
+    REGS_LOCAL->control = 0;
+    REGS_LOCAL->core_timer_prescaler = 0x80000000;
+
+    irq_register(IRQ_LOCAL_CNTV, handle_arch_timer, NULL);
+    irq_register(IRQ_LOCAL_CNTPNS, handle_arch_timer, NULL);
+
+    arch_timer_init_core();
+}
+
+//one-shot on the calling core at an absolute counter value, fn runs from its IRQ with IRQs masked
+void arch_timer_start_at(u32 timer, u64 counter, arch_timer_fn fn, void *arg) {
+    arch_timer_slot *slot = this_cpu_ptr(&arch_timers[timer]);
+
+    slot->fn = fn;
+    slot->arg = arg;
+
+    arch_timer_write_cval(timer, counter);
+    arch_timer_write_ctl(timer, ARCH_TIMER_CTL_ENABLE);
+}
+
+void arch_timer_start(u32 timer, u64 delay_ns, arch_timer_fn fn, void *arg) {
+    arch_timer_start_at(timer, arch_counter() + ns_to_arch_ticks(delay_ns), fn, arg);
+}
+
+void arch_timer_stop(u32 timer) {
+    arch_timer_write_ctl(timer, 0);
+}
+
+//the timer IRQ is level triggered while ISTATUS is set, disable before the callback
+static void handle_arch_timer(u32 irq, void *ctx) {
+    u32 timer = irq == IRQ_LOCAL_CNTV ? ARCH_TIMER_VIRT : ARCH_TIMER_PHYS;
+    arch_timer_slot *slot = this_cpu_ptr(&arch_timers[timer]);
+
+    arch_timer_write_ctl(timer, 0);
+
+    if (slot->fn) {
+        slot->fn(slot->arg);
+    }
+}
+
+typedef struct {
+    u64 deadline;
+    u64 late_ns[NUM_CORES];
+    volatile u32 done;
+} arch_timer_probe;
+
+static arch_timer_probe probe;
+
+static void arch_timer_probe_fired(void *arg) {
+    u64 now = arch_counter();
+
+    probe.late_ns[cpu_id()] = (now - probe.deadline) * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV;
+    __atomic_add_fetch(&probe.done, 1, __ATOMIC_RELEASE);
+}
+
+static void arch_timer_probe_arm(void *arg) {
+    arch_timer_start_at(ARCH_TIMER_VIRT, probe.deadline, arch_timer_probe_fired, NULL);
+}
+
+//timestamp cost against the system timer MMIO read, then every core's CNTV armed for the same instant
+void arch_timer_test() {
+    const u32 reads = 1000;
+
+    u64 start = arch_counter();
+    for (u32 i=0; i<reads; i++) {
+        timer_get_systimer();
+    }
+    u64 ticks_cost = arch_counter() - start;
+
+    start = arch_counter();
+    for (u32 i=0; i<reads; i++) {
+        clock_ns();
+    }
+    u64 ns_cost = arch_counter() - start;
+
+    printf("Generic timer: %d Hz, %d reads: system timer %d ns, clock_ns %d ns\n",
+        (u32)arch_counter_freq(), reads,
+        (u32)(ticks_cost * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV),
+        (u32)(ns_cost * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV));
+
+    u32 mask = cpu_online_mask();
+    u32 cores = __builtin_popcount(mask);
+
+    probe.done = 0;
+    probe.deadline = arch_counter() + ns_to_arch_ticks(1000000);
+    ipi_call(mask, arch_timer_probe_arm, NULL, true);
+
+    while(__atomic_load_n(&probe.done, __ATOMIC_ACQUIRE) < cores) ;
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        if (mask & (1 << core)) {
+            printf("\tcore %d CNTV one-shot fired %d ns late\n",
+                core, (u32)probe.late_ns[core]);
+        }
+    }
+}
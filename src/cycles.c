@@ -0,0 +1,156 @@
+#include "cycles.h"
+#include "arch_timer.h"
+#include "spinlock.h"
+#include "printf.h"
+
+static cycle_site *sites = NULL;
+static spinlock sites_lock = SPINLOCK_INIT;
+
+//measured against the generic counter, the ARM clock is set by the firmware
+static u32 cycles_per_us = 1;
+
+void pmu_init_core() {
+    u64 pmcr;
+
+    asm volatile("mrs %0, pmcr_el0" : "=r"(pmcr));
+    pmcr |= PMCR_E | PMCR_C | PMCR_LC;
+    asm volatile("msr pmcr_el0, %0" : : "r"(pmcr));
+
+    //count in EL0 and EL1, no filtering
+    asm volatile("msr pmccfiltr_el0, xzr");
+    asm volatile("msr pmcntenset_el0, %0" : : "r"((u64)PMCNTEN_CYCLES));
+    asm volatile("msr pmuserenr_el0, %0" : : "r"((u64)(PMUSERENR_EN | PMUSERENR_CR)));
+    asm volatile("isb");
+}
+
+static const u32 pmu_events[PMU_EVENTS] = PMU_EVENT_LIST;
+
+//the event counters have to be named in the instruction, no indexing
+#define PMU_SET_TYPE(n, ev) asm volatile("msr pmevtyper" #n "_el0, %0" : : "r"((u64)(ev)))
+#define PMU_GET_COUNT(n, v) asm volatile("mrs %0, pmevcntr" #n "_el0" : "=r"(v))
+
+//counts EL0 and EL1 like the cycle counter. Only the event counters are reset, the
+//cycle counter keeps running under any CYCLE_SCOPE in flight.
+void pmu_events_start(pmu_sample *sample) {
+    u64 pmcr;
+
+    PMU_SET_TYPE(0, pmu_events[0]);
+    PMU_SET_TYPE(1, pmu_events[1]);
+    PMU_SET_TYPE(2, pmu_events[2]);
+    PMU_SET_TYPE(3, pmu_events[3]);
+
+    asm volatile("mrs %0, pmcr_el0" : "=r"(pmcr));
+    asm volatile("msr pmcr_el0, %0" : : "r"(pmcr | PMCR_P));
+    asm volatile("msr pmcntenset_el0, %0" : : "r"((u64)(PMCNTEN_CYCLES | 0xF)));
+
+    sample->cycles = cycles_now();
+}
+
+void pmu_events_read(pmu_sample *sample) {
+    u64 v;
+
+    sample->cycles = cycles_now() - sample->cycles;
+
+    PMU_GET_COUNT(0, v);
+    sample->events[0] = (u32)v;
+    PMU_GET_COUNT(1, v);
+    sample->events[1] = (u32)v;
+    PMU_GET_COUNT(2, v);
+    sample->events[2] = (u32)v;
+    PMU_GET_COUNT(3, v);
+    sample->events[3] = (u32)v;
+}
+
+//1ms against the generic counter
+void pmu_calibrate() {
+    u64 end = arch_counter() + ns_to_arch_ticks(1000000);
+    u64 start = cycles_now();
+
+    while(arch_counter() < end) ;
+
+    cycles_per_us = (u32)((cycles_now() - start) / 1000);
+
+    if (!cycles_per_us) {
+        cycles_per_us = 1;
+    }
+}
+
+u32 cpu_cycles_per_us() {
+    return cycles_per_us;
+}
+
+u64 cycles_to_ns(u64 cycles) {
+    return cycles * 1000 / cycles_per_us;
+}
+
+static void cycle_site_register(cycle_site *site) {
+    u64 flags = spin_lock_irqsave(&sites_lock);
+
+    if (!site->registered) {
+        for (u32 core=0; core<NUM_CORES; core++) {
+            site->per_core[core].min = ~0ULL;
+        }
+
+        site->next = sites;
+        sites = site;
+
+        //publishes the min reset to the lock-free check in cycle_site_record
+        __atomic_store_n(&site->registered, true, __ATOMIC_RELEASE);
+    }
+
+    spin_unlock_irqrestore(&sites_lock, flags);
+}
+
+void cycle_site_record(cycle_site *site, u64 cycles) {
+    if (!__atomic_load_n(&site->registered, __ATOMIC_ACQUIRE)) {
+        cycle_site_register(site);
+    }
+
+    cycle_stats *stats = &site->per_core[cpu_id()];
+
+    stats->count++;
+    stats->total += cycles;
+    if (cycles < stats->min) stats->min = cycles;
+    if (cycles > stats->max) stats->max = cycles;
+}
+
+void cycle_site_reset(cycle_site *site) {
+    for (u32 core=0; core<NUM_CORES; core++) {
+        site->per_core[core].count = 0;
+        site->per_core[core].total = 0;
+        site->per_core[core].min = ~0ULL;
+        site->per_core[core].max = 0;
+    }
+}
+
+//all cores folded together, remote rows may be mid-update
+void cycle_report() {
+    printf("Cycle scopes (%d cycles/us):\n", cycles_per_us);
+
+    for (cycle_site *site = sites; site; site = site->next) {
+        cycle_stats sum = { 0, 0, ~0ULL, 0 };
+
+        for (u32 core=0; core<NUM_CORES; core++) {
+            cycle_stats *s = &site->per_core[core];
+
+            sum.count += s->count;
+            sum.total += s->total;
+            if (s->count && s->min < sum.min) sum.min = s->min;
+            if (s->max > sum.max) sum.max = s->max;
+        }
+
+        if (!sum.count) {
+            continue;
+        }
+
+        printf("\t%s: %d calls, min %d avg %d max %d cycles (avg %d ns)\n", site->name,
+            (u32)sum.count, (u32)sum.min, (u32)(sum.total / sum.count), (u32)sum.max,
+            (u32)cycles_to_ns(sum.total / sum.count));
+    }
+}
+
+void cycle_report_reset() {
+    for (cycle_site *site = sites; site; site = site->next) {
+        cycle_site_reset(site);
+    }
+}
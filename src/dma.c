@@ -3,10 +3,28 @@
 #include "mem.h"
 #include "timer.h"
 #include "printf.h"
+#include "irq.h"
+#include "smp.h"
+#include "ring_buffer.h"
+#include "wait.h"
+#include "arch_timer.h"
 
 dma_channel channels[15];
 
+//completion records pushed by the DMA IRQ: channel | seq << 8 | error << 63
+static mpmc_ring *completions = NULL;
+
+static wait_queue dma_wq = WAIT_QUEUE_INIT;
+
+static void handle_dma_irq(u32 irq, void *ctx);
+
+#define COMPLETION(channel, seq, error) ((u64)(channel) | ((u64)(seq) << 8) | ((u64)(error) << 63))
+
 static u16 channel_map = 0x1F35;
+#define CHANNELS_FREE 0x1F35
+
+//start of the dma_report() window
+static u64 report_since = 0;
 
 static u16 allocate_channel(u32 channel){
     if(!(channel & ~0x0F)){
@@ -33,8 +51,21 @@ dma_channel*dma_open_channel(u32 channel){
         printf("INVALID CHANNEL!%d\n",channel);
     }
 
+    if (!completions) {
+        completions = mpmc_ring_create();
+        report_since = arch_counter();
+    }
+
     dma_channel *dma = (dma_channel *)&channels[_channel];
     dma->channel = _channel;
+    dma->seq = 0;
+    dma->done_seq = 0;
+    dma->callback = NULL;
+    dma->callback_ctx = NULL;
+    dma->busy_since = 0;
+    dma->busy_ticks = 0;
+    dma->bytes = 0;
+    dma->transfers = 0;
 
     // dma->block = (dma_control_block *)((LOW_MEMORY +31)&~31);
     dma->block =(dma_control_block *)allocate_memory(sizeof(dma_control_block));
@@ -47,11 +78,14 @@ dma_channel*dma_open_channel(u32 channel){
 
     while(REGS_DMA(dma->channel)->control & CS_RESET) ;
 
+    irq_register(IRQ_DMA(dma->channel), handle_dma_irq, dma);
+
     return dma;
 }
 
 
 void dma_close_channel(dma_channel *channel) {
+    irq_unregister(IRQ_DMA(channel->channel));
     channel_map |= (1 << channel->channel);
 }
 
@@ -62,7 +96,8 @@ void dma_setup_mem_copy(dma_channel *channel, void *dest, void *src, u32 length,
 						    | TI_SRC_WIDTH
 						    | TI_SRC_INC
 						    | TI_DEST_WIDTH
-						    | TI_DEST_INC;
+						    | TI_DEST_INC
+						    | TI_INTEN;
 
     channel->block->src_addr = (u32)src;
     channel->block->dest_addr = (u32)dest;
@@ -71,8 +106,31 @@ void dma_setup_mem_copy(dma_channel *channel, void *dest, void *src, u32 length,
     channel->block->next_block_addr = 0;
 }
 
+//paced by the peripheral's DREQ, one 32-bit write into dev_addr per src word
+void dma_setup_dev_write(dma_channel *channel, u32 dev_addr, void *src, u32 length, u32 dreq) {
+    channel->block->transfer_info = (dreq << TI_PERMAP_SHIFT)
+                            | TI_SRC_INC
+                            | TI_DEST_DREQ
+                            | TI_WAIT_RESP
+                            | TI_INTEN;
+
+    channel->block->src_addr = (u32)src;
+    channel->block->dest_addr = dev_addr;
+    channel->block->transfer_length = length;
+    channel->block->mode_2d_stride = 0;
+    channel->block->next_block_addr = 0;
+}
+
+void dma_set_callback(dma_channel *channel, dma_callback callback, void *ctx) {
+    channel->callback_ctx = ctx;
+    channel->callback = callback;
+}
+
 void dma_start(dma_channel *channel) {
-   
+    channel->seq++;
+    channel->transfers++;
+    channel->bytes += channel->block->transfer_length;
+    channel->busy_since = arch_counter();
 
       asm volatile("dsb sy");
     REGS_DMA(channel->channel)->control_block_addr = BUS_ADDRESS((u32)channel->block);
@@ -86,11 +144,111 @@ void dma_start(dma_channel *channel) {
 
   
 
+//the IRQ and a polling waiter can both see the end of a transfer, only one counts it
+static void dma_account(dma_channel *channel) {
+    u64 since = __atomic_exchange_n(&channel->busy_since, 0, __ATOMIC_RELAXED);
+
+    if (since) {
+        channel->busy_ticks += arch_counter() - since;
+    }
+}
+
+//one registration per open channel, ctx is the channel
+static void handle_dma_irq(u32 irq, void *ctx) {
+    dma_channel *channel = (dma_channel *)ctx;
+    u32 ch = channel->channel;
+
+    dma_account(channel);
+
+    u32 cs = REGS_DMA(ch)->control;
+    REGS_DMA(ch)->control = CS_INT;
+
+    mpmc_ring_push(completions, COMPLETION(ch, channel->seq, (cs & CS_ERROR) != 0));
+
+    if (channel->callback) {
+        channel->callback(channel, channel->callback_ctx);
+    }
+
+    wake_up_all(&dma_wq);
+}
+
+static void dma_process_completions() {
+    u64 c;
+
+    while(mpmc_ring_pop(completions, &c)) {
+        dma_channel *channel = &channels[c & 0xFF];
+
+        //stale records (the waiter already polled the channel) are dropped
+        if ((u32)(c >> 8) == channel->seq) {
+            channel->status = (c >> 63) ? false : true;
+            channel->done_seq = channel->seq;
+        }
+    }
+}
+
+static bool dma_done(dma_channel *channel) {
+    dma_process_completions();
+
+    return channel->done_seq == channel->seq;
+}
+
 bool dma_wait(dma_channel *channel) {
-    while(REGS_DMA(channel->channel)->control & CS_ACTIVE) ;
+    //the DMA IRQ runs on core 0, waiters on other cores are woken by IPI
+    if (!irq_disabled()) {
+        wait_event(&dma_wq, dma_done(channel));
+        return channel->status;
+    }
 
-    channel->status = REGS_DMA(channel->channel)->control & CS_ERROR ? false : true;
+    while(!dma_done(channel)) {
+        if (!(REGS_DMA(channel->channel)->control & CS_ACTIVE)) {
+            dma_account(channel);
+            channel->status = REGS_DMA(channel->channel)->control & CS_ERROR ? false : true;
+            channel->done_seq = channel->seq;
+        }
+    }
 
     return channel->status;
+}
+
+void dma_report() {
+    u64 now = arch_counter();
+    u64 window = now - report_since;
+    u16 open = CHANNELS_FREE & ~channel_map;
 
-}
\ No newline at end of file
+    printf("DMA channels (%d us window):\n", (u32)(window * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV / 1000));
+
+    for (u32 ch=0; ch<15; ch++) {
+        dma_channel *channel = &channels[ch];
+
+        if (!(open & (1 << ch))) {
+            continue;
+        }
+
+        //keeps the completion IRQ out while the window is cut
+        u64 flags = irq_save();
+
+        //a transfer still running is charged up to now and restarts the next window
+        u64 since = channel->busy_since;
+        u64 busy = channel->busy_ticks;
+
+        if (since && __atomic_compare_exchange_n(&channel->busy_since, &since, now, false,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            busy += now - since;
+        }
+
+        u32 transfers = channel->transfers;
+        u64 bytes = channel->bytes;
+
+        channel->transfers = 0;
+        channel->bytes = 0;
+        channel->busy_ticks = 0;
+        irq_restore(flags);
+
+        u32 util = window ? (u32)(busy * 1000 / window) : 0;
+
+        printf("\tchannel %d: %d transfers %d KB busy %d.%d%%%s\n", ch, transfers,
+            (u32)(bytes / 1024), util / 10, util % 10, since ? " (active)" : "");
+    }
+
+    report_since = now;
+}
@@ -0,0 +1,282 @@
+#include "fiq.h"
+#include "smp.h"
+#include "percpu.h"
+#include "cycles.h"
+#include "utils.h"
+#include "arch_timer.h"
+#include "printf.h"
+#include "peripherals/irq.h"
+#include "peripherals/local.h"
+#include "peripherals/timer.h"
+
+typedef struct {
+    u32 irq;
+    u32 core;               //local sources only: the core whose routing we changed
+    u32 saved_ctrl;         //its routing register before the claim
+    irq_handler handler;
+    void *ctx;
+} fiq_source;
+
+#define FIQ_NONE NR_IRQS
+
+static fiq_source source = { FIQ_NONE, 0, 0, NULL, NULL };
+
+//in the kernel image, so unlike the core stacks these are cacheable
+static u8 fiq_stacks[NUM_CORES][FIQ_STACK_SIZE] __attribute__((aligned(16)));
+
+static DEFINE_PER_CPU(fiq_stat, fiq_stats);
+
+void fiq_init_core() {
+    u64 top = (u64)(fiq_stacks[cpu_id()] + FIQ_STACK_SIZE);
+
+    asm volatile("msr sp_el0, %0" : : "r"(top));
+    fiq_enable();
+}
+
+//local routing register of the source, NULL for the ones that cannot be FIQ here
+static reg32 *fiq_local_ctrl(u32 irq, u32 core, u32 *irq_bit, u32 *fiq_bit) {
+    u32 bit = 1 << (irq - IRQ_LOCAL(0));
+
+    if (bit & (LOCAL_IRQ_CNTPS | LOCAL_IRQ_CNTPNS | LOCAL_IRQ_CNTHP | LOCAL_IRQ_CNTV)) {
+        *irq_bit = bit;
+        *fiq_bit = TIMER_FIQ_ENABLE(bit);
+        return &REGS_LOCAL->core_timer_int_ctrl[core];
+    }
+
+    for (u32 mailbox=0; mailbox<4; mailbox++) {
+        if (bit == LOCAL_IRQ_MAILBOX(mailbox)) {
+            *irq_bit = MAILBOX_IRQ_ENABLE(mailbox);
+            *fiq_bit = MAILBOX_FIQ_ENABLE(mailbox);
+            return &REGS_LOCAL->core_mailbox_int_ctrl[core];
+        }
+    }
+
+    return NULL;
+}
+
+static void fiq_gpu_route(u32 irq, bool enable) {
+#if RPI_VERSION == 3
+    //the FIQ source numbering is the same as ours for VC and ARM basic
+    REGS_IRQ->fiq_control = enable ? (FIQ_CONTROL_ENABLE | irq) : 0;
+#endif
+
+#if RPI_VERSION == 4
+    u32 bit = irq >= IRQ_ARM(0) ? 1 << (irq - IRQ_ARM(0)) : 1 << (irq % 32);
+
+    if (irq >= IRQ_ARM(0)) {
+        if (enable) REGS_FIQ_2711->fiq0_enable_2 = bit; else REGS_FIQ_2711->fiq0_disable_2 = bit;
+    } else if (irq >= IRQ_VC(32)) {
+        if (enable) REGS_FIQ_2711->fiq0_enable_1 = bit; else REGS_FIQ_2711->fiq0_disable_1 = bit;
+    } else {
+        if (enable) REGS_FIQ_2711->fiq0_enable_0 = bit; else REGS_FIQ_2711->fiq0_disable_0 = bit;
+    }
+#endif
+}
+
+//a VC/ARM source loses its IRQ registration, its driver registers again after fiq_release()
+bool fiq_claim(u32 irq, irq_handler handler, void *ctx) {
+    if (irq >= NR_IRQS || !handler || source.irq != FIQ_NONE) {
+        return false;
+    }
+
+    if (irq >= IRQ_LOCAL(0)) {
+        u32 core = cpu_id();
+        u32 irq_bit;
+        u32 fiq_bit;
+        reg32 *ctrl = fiq_local_ctrl(irq, core, &irq_bit, &fiq_bit);
+
+        if (!ctrl) {
+            return false;
+        }
+
+        source.core = core;
+        source.saved_ctrl = *ctrl;
+        source.handler = handler;
+        source.ctx = ctx;
+        source.irq = irq;
+        asm volatile("dsb sy");
+
+        *ctrl = (*ctrl & ~irq_bit) | fiq_bit;
+    } else {
+        if (irq >= IRQ_ARM(0) + 8) {
+            return false;
+        }
+
+        irq_unregister(irq);
+
+        source.handler = handler;
+        source.ctx = ctx;
+        source.irq = irq;
+        asm volatile("dsb sy");
+
+        fiq_gpu_route(irq, true);
+    }
+
+    return true;
+}
+
+void fiq_release() {
+    u32 irq = source.irq;
+
+    if (irq == FIQ_NONE) {
+        return;
+    }
+
+    if (irq >= IRQ_LOCAL(0)) {
+        u32 irq_bit;
+        u32 fiq_bit;
+
+        *fiq_local_ctrl(irq, source.core, &irq_bit, &fiq_bit) = source.saved_ctrl;
+    } else {
+        fiq_gpu_route(irq, false);
+    }
+
+    asm volatile("dsb sy");
+
+    source.irq = FIQ_NONE;
+    source.handler = NULL;
+    source.ctx = NULL;
+}
+
+//called from handle_el1_fiq with IRQs and FIQs masked
+void handle_fiq() {
+    irq_handler handler = source.handler;
+
+    if (!handler) {
+        return;
+    }
+
+    fiq_stat *stat = this_cpu_ptr(&fiq_stats);
+    u64 start = cycles_now();
+
+    handler(source.irq, source.ctx);
+
+    u64 cycles = cycles_now() - start;
+
+    stat->count++;
+    stat->total_cycles += cycles;
+    if (cycles > stat->max_cycles) stat->max_cycles = cycles;
+}
+
+fiq_stat *fiq_get_stat(u32 core) {
+    return per_cpu_ptr(&fiq_stats, core);
+}
+
+typedef struct {
+    u64 deadline;
+    u64 min;
+    u64 max;
+    u64 total;
+    volatile bool fired;
+} fiq_probe;
+
+static fiq_probe probe;
+
+static void fiq_probe_record(u64 now) {
+    u64 late = now - probe.deadline;
+
+    if (late < probe.min) probe.min = late;
+    if (late > probe.max) probe.max = late;
+    probe.total += late;
+
+    probe.fired = true;
+}
+
+//CNTPNS routed to FIQ: nothing else stops the timer
+static void fiq_probe_fiq(u32 irq, void *ctx) {
+    u64 now = arch_counter();
+
+    arch_timer_stop(ARCH_TIMER_PHYS);
+    fiq_probe_record(now);
+}
+
+static void fiq_probe_irq(void *arg) {
+    fiq_probe_record(arch_counter());
+}
+
+//system timer 1 (free outside irq_latency_test) as a long IRQ handler
+static u32 fiq_busy_ns;
+
+static void fiq_busy_handler(u32 irq, void *ctx) {
+    REGS_TIMER->control_status = SYS_TIMER_IRQ_1;
+    ndelay(fiq_busy_ns);
+}
+
+//IRQ-masked sections with each deadline landing somewhere inside one: a spin_lock_irqsave
+//region, or with in_handler a registered IRQ handler, so the FIQ has to get in through
+//the IRQ entry path
+static void fiq_probe_run(const char *path, u32 samples, u32 masked_ns, bool fiq, bool in_handler) {
+    probe.min = ~0ULL;
+    probe.max = 0;
+    probe.total = 0;
+
+    if (in_handler) {
+        fiq_busy_ns = masked_ns;
+        irq_register(IRQ_SYS_TIMER(1), fiq_busy_handler, NULL);
+    }
+
+    for (u32 i=0; i<samples; i++) {
+        u64 offset_ns = masked_ns / 4 + (i * 7919) % (masked_ns / 2);
+
+        probe.fired = false;
+        probe.deadline = arch_counter() + ns_to_arch_ticks(offset_ns);
+
+        arch_timer_start_at(ARCH_TIMER_PHYS, probe.deadline, fiq ? NULL : fiq_probe_irq, NULL);
+
+        if (in_handler) {
+            //a tick or two away, well before the quarter of masked_ns the deadline has
+            REGS_TIMER->compare[1] = REGS_TIMER->counter_lo + 2;
+        } else {
+            u64 flags = irq_save();
+            ndelay(masked_ns);
+            irq_restore(flags);
+        }
+
+        while(!probe.fired) ;
+    }
+
+    if (in_handler) {
+        irq_unregister(IRQ_SYS_TIMER(1));
+    }
+
+    if (!samples) {
+        printf("\t%s: no samples\n", path);
+        return;
+    }
+
+    printf("\t%s: min %d ns avg %d ns max %d ns\n", path,
+        (u32)(probe.min * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV),
+        (u32)(probe.total / samples * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV),
+        (u32)(probe.max * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV));
+}
+
+//deadline -> handler for this core's CNTPNS, as IRQ and claimed as FIQ, behind an
+//irq_save() section and inside an IRQ handler
+void fiq_latency_test(u32 samples) {
+    const u32 masked_ns = 50000;
+
+    printf("FIQ latency (%d samples, IRQs masked %d us around each deadline):\n",
+        samples, masked_ns / 1000);
+
+    fiq_probe_run("IRQ", samples, masked_ns, false, false);
+    fiq_probe_run("IRQ, in an IRQ handler", samples, masked_ns, false, true);
+
+    if (!fiq_claim(IRQ_LOCAL_CNTPNS, fiq_probe_fiq, NULL)) {
+        printf("\tFIQ: source busy\n");
+        return;
+    }
+
+    fiq_probe_run("FIQ", samples, masked_ns, true, false);
+    fiq_probe_run("FIQ, in an IRQ handler", samples, masked_ns, true, true);
+    fiq_release();
+
+    fiq_stat *stat = fiq_get_stat(cpu_id());
+
+    if (!stat->count) {
+        printf("\tFIQ handler: no samples\n");
+        return;
+    }
+
+    printf("\tFIQ handler: %d calls, avg %d max %d cycles\n", stat->count,
+        (u32)(stat->total_cycles / stat->count), stat->max_cycles);
+}
@@ -0,0 +1,110 @@
+#include "fpsimd.h"
+#include "percpu.h"
+#include "smp.h"
+#include "printf.h"
+#include "sysregs.h"
+#include "libcpp/assert.h"
+
+#define FPSIMD_NONE 0xFFFFFFFF
+
+//invariant: FP/SIMD is enabled in CPACR exactly when owner == depth
+typedef struct {
+    u32 depth;                      //0 thread, n inside n nested IRQs
+    u32 owner;                      //context whose state is in the registers
+    bool saved[FPSIMD_MAX_DEPTH];   //context state parked in fpsimd_area
+    fpsimd_stats stats;
+} fpsimd_cpu;
+
+static DEFINE_PER_CPU(fpsimd_cpu, fpsimd);
+
+static fpsimd_state fpsimd_area[NUM_CORES][FPSIMD_MAX_DEPTH] __attribute__((aligned(16)));
+
+static void fpsimd_access(bool enable) {
+    u64 cpacr;
+
+    asm volatile("mrs %0, cpacr_el1" : "=r"(cpacr));
+    cpacr = enable ? (cpacr | CPACR_EL1_FPEN) : (cpacr & ~CPACR_EL1_FPEN);
+    asm volatile("msr cpacr_el1, %0; isb" : : "r"(cpacr));
+}
+
+void fpsimd_init_core() {
+    fpsimd_cpu *fp = this_cpu_ptr(&fpsimd);
+
+    fp->depth = 0;
+    fp->owner = FPSIMD_NONE;
+    fpsimd_access(false);
+}
+
+void fpsimd_irq_enter() {
+    fpsimd_cpu *fp = this_cpu_ptr(&fpsimd);
+
+    //the interrupted context has live registers: trap if the handler wants them
+    if (fp->owner == fp->depth++) {
+        fpsimd_access(false);
+    }
+}
+
+void fpsimd_irq_exit() {
+    fpsimd_cpu *fp = this_cpu_ptr(&fpsimd);
+
+    fp->saved[fp->depth] = false;
+
+    //the IRQ's own registers die with it
+    if (fp->owner == fp->depth) {
+        fp->owner = FPSIMD_NONE;
+        fp->depth--;
+        fpsimd_access(false);
+        return;
+    }
+
+    //nobody touched the interrupted context's registers, give them straight back
+    if (fp->owner == --fp->depth) {
+        fpsimd_access(true);
+    }
+}
+
+//EC 0x07 from EL1h: park whoever owns the registers, bring ours back if parked
+void fpsimd_trap() {
+    fpsimd_cpu *fp = this_cpu_ptr(&fpsimd);
+    fpsimd_state *area = fpsimd_area[cpu_id()];
+    u32 depth = fp->depth;
+
+    if (depth >= FPSIMD_MAX_DEPTH) {
+        panic("FP/SIMD used too deep in nested IRQs", __FILE__, __LINE__);
+    }
+
+    fp->stats.traps++;
+    fpsimd_access(true);
+
+    if (fp->owner != FPSIMD_NONE) {
+        fpsimd_save_regs(&area[fp->owner]);
+        fp->saved[fp->owner] = true;
+        fp->stats.saves++;
+    }
+
+    if (fp->saved[depth]) {
+        fpsimd_load_regs(&area[depth]);
+        fp->saved[depth] = false;
+        fp->stats.restores++;
+    }
+
+    fp->owner = depth;
+}
+
+fpsimd_stats *fpsimd_get_stats(u32 core) {
+    return &per_cpu_ptr(&fpsimd, core)->stats;
+}
+
+void fpsimd_report() {
+    printf("FP/SIMD lazy context:\n");
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        if (!cpu_is_online(core)) {
+            continue;
+        }
+
+        fpsimd_stats *s = fpsimd_get_stats(core);
+
+        printf("\tcore %d: %d traps %d saves %d restores\n", core, s->traps, s->saves, s->restores);
+    }
+}
@@ -3,6 +3,8 @@
 #include"mem.h"
 #include"mm.h"
 #include"printf.h"
+#include"percpu.h"
+#include"spinlock.h"
 
 
 // #define HEAP_START 0x80000000   // Adjust based on linker script
@@ -10,10 +12,138 @@
 
 heap_block_t *free_list;
 
+//guards free_list and the slab depots
+static spinlock heap_lock = SPINLOCK_INIT;
+
+static const u32 heap_class_size[HEAP_NUM_CLASSES] = {16, 32, 64, 128, 256, 512};
+
+//global per-class free objects, linked through heap_block_t.next
+static heap_block_t *slab_depot[HEAP_NUM_CLASSES];
+
+typedef struct {
+    u32 count;
+    heap_block_t *objs[HEAP_MAGAZINE_SIZE];
+} heap_magazine;
+
+typedef struct {
+    heap_magazine mags[HEAP_NUM_CLASSES];
+    cache_stats stats;
+} heap_cpu_cache;
+
+static DEFINE_PER_CPU(heap_cpu_cache, heap_caches);
+
 void heap_init() {
     free_list = NULL;
 }
 
+static int heap_class_index(size_t size) {
+    for (int c = 0; c < HEAP_NUM_CLASSES; c++) {
+        if (size <= heap_class_size[c])
+            return c;
+    }
+
+    return -1;
+}
+
+//called with heap_lock held
+static void slab_carve_page(int class) {
+    u8 *page = (u8 *)get_free_page();
+
+    if (!page)
+        return;
+
+    u32 stride = sizeof(heap_block_t) + heap_class_size[class];
+
+    for (u32 off = 0; off + stride <= PAGE_SIZE; off += stride) {
+        heap_block_t *obj = (heap_block_t *)(page + off);
+
+        obj->size = heap_class_size[class];
+        obj->free = HEAP_BLOCK_SLAB;
+        obj->next = slab_depot[class];
+        slab_depot[class] = obj;
+    }
+}
+
+static void heap_magazine_refill(heap_magazine *mag, int class) {
+    spin_lock(&heap_lock);
+
+    if (!slab_depot[class])
+        slab_carve_page(class);
+
+    while (slab_depot[class] && mag->count < HEAP_MAGAZINE_BATCH) {
+        heap_block_t *obj = slab_depot[class];
+
+        slab_depot[class] = obj->next;
+        mag->objs[mag->count++] = obj;
+    }
+
+    spin_unlock(&heap_lock);
+}
+
+//the oldest batch goes back to the depot, recently freed (warm) objects stay
+static void heap_magazine_drain(heap_magazine *mag, int class) {
+    spin_lock(&heap_lock);
+
+    for (u32 i = 0; i < HEAP_MAGAZINE_BATCH; i++) {
+        heap_block_t *obj = mag->objs[i];
+
+        obj->next = slab_depot[class];
+        slab_depot[class] = obj;
+    }
+
+    spin_unlock(&heap_lock);
+
+    mag->count -= HEAP_MAGAZINE_BATCH;
+
+    for (u32 i = 0; i < mag->count; i++)
+        mag->objs[i] = mag->objs[i + HEAP_MAGAZINE_BATCH];
+}
+
+static void *slab_alloc(int class) {
+    u64 flags = irq_save();
+    heap_cpu_cache *cache = this_cpu_ptr(&heap_caches);
+    heap_magazine *mag = &cache->mags[class];
+    heap_block_t *obj = NULL;
+
+    if (mag->count) {
+        cache->stats.hits++;
+    } else {
+        cache->stats.misses++;
+        cache->stats.refills++;
+        heap_magazine_refill(mag, class);
+    }
+
+    if (mag->count)
+        obj = mag->objs[--mag->count];
+
+    irq_restore(flags);
+
+    return obj ? (char *)obj + sizeof(heap_block_t) : NULL;
+}
+
+static void slab_free(heap_block_t *obj) {
+    int class = heap_class_index(obj->size);
+    u64 flags = irq_save();
+    heap_cpu_cache *cache = this_cpu_ptr(&heap_caches);
+    heap_magazine *mag = &cache->mags[class];
+
+    if (mag->count == HEAP_MAGAZINE_SIZE) {
+        cache->stats.misses++;
+        cache->stats.drains++;
+        heap_magazine_drain(mag, class);
+    } else {
+        cache->stats.hits++;
+    }
+
+    mag->objs[mag->count++] = obj;
+
+    irq_restore(flags);
+}
+
+cache_stats *heap_cache_stats(u32 core) {
+    return &per_cpu_ptr(&heap_caches, core)->stats;
+}
+
 static heap_block_t* heap_expand() {
     void* page = allocate_memory(PAGE_SIZE);
     if (!page)
@@ -33,6 +163,11 @@ void *malloc(size_t size) {
 
     size = (size + 7) & ~7; // 8-byte alignment
 
+    if (size <= HEAP_MAX_CLASS_SIZE)
+        return slab_alloc(heap_class_index(size));
+
+    u64 flags = spin_lock_irqsave(&heap_lock);
+
     heap_block_t *curr = free_list;
     heap_block_t *prev = NULL;
 
@@ -47,8 +182,10 @@ void *malloc(size_t size) {
     // If no suitable block found → expand heap
     if (!curr) {
         heap_block_t* new_block = heap_expand();
-        if (!new_block)
+        if (!new_block) {
+            spin_unlock_irqrestore(&heap_lock, flags);
             return NULL;
+        }
 
         if (!free_list)
             free_list = new_block;
@@ -71,7 +208,9 @@ void *malloc(size_t size) {
         curr->size = size;
     }
 
-    curr->free = 0;
+    curr->free = HEAP_BLOCK_USED;
+
+    spin_unlock_irqrestore(&heap_lock, flags);
 
     return (char *)curr + sizeof(heap_block_t);
 }
@@ -83,7 +222,14 @@ void free(void *ptr) {
     heap_block_t *block =
         (heap_block_t *)((char *)ptr - sizeof(heap_block_t));
 
-    block->free = 1;
+    if (block->free == HEAP_BLOCK_SLAB) {
+        slab_free(block);
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&heap_lock);
+
+    block->free = HEAP_BLOCK_FREE;
 
     // Merge physically adjacent free blocks
     heap_block_t *curr = free_list;
@@ -99,6 +245,8 @@ void free(void *ptr) {
             curr = curr->next;
         }
     }
+
+    spin_unlock_irqrestore(&heap_lock, flags);
 }
 
 
@@ -163,4 +311,5 @@ void heap_stress_test() {
     }
 
     printf("Heap allocator test ENDED\n");
+    cache_stats_report("Heap object", heap_cache_stats);
 }
\ No newline at end of file
@@ -2,16 +2,49 @@
 #include "peripherals/i2c.h"
 #include "i2c.h"
 #include "printf.h"
+#include "irq.h"
+#include "wait.h"
 
 #define I2C_SPEED 100000
 
+#define C_INT_ALL (C_INTR | C_INTT | C_INTD)
+
+static wait_queue i2c_wq = WAIT_QUEUE_INIT;
+
+//level triggered: mask in the controller, the waiter re-arms what it needs
+static void handle_i2c_irq(u32 irq, void *ctx) {
+    REGS_I2C->control &= ~C_INT_ALL;
+    wake_up_all(&i2c_wq);
+}
+
+//true once any of the status bits is up, otherwise arms the matching interrupts
+static bool i2c_ready(u32 status_mask, u32 int_mask) {
+    if (REGS_I2C->status & status_mask) {
+        return true;
+    }
+
+    REGS_I2C->control |= int_mask;
+
+    return (REGS_I2C->status & status_mask) != 0;
+}
+
+//blocks while the FIFO has nothing for us (receive) or no room (send)
+static void i2c_wait(u32 status_mask, u32 int_mask) {
+    if (irq_disabled()) {
+        return;
+    }
+
+    wait_event(&i2c_wq, i2c_ready(status_mask, int_mask));
+}
+
 void i2c_init(){
     gpio_pin_set_func(2,GFAlt0);
     gpio_pin_set_func(3,GFAlt0);
-    gpio_pin_enable(2);
-    gpio_pin_enable(3);
+    gpio_pins_enable((1ULL << 2) | (1ULL << 3));
 
     REGS_I2C->div = CORE_CLOCK_SPEED/I2C_SPEED; 
+
+    irq_register(IRQ_I2C, handle_i2c_irq, NULL);
 } 
 
 i2c_status i2c_recv(u8 address, u8 *buffer, u32 size){
@@ -28,6 +61,8 @@ i2c_status i2c_recv(u8 address, u8 *buffer, u32 size){
             *buffer++ = REGS_I2C->fifo & 0xFF;
             count++;
         }
+
+        i2c_wait(S_DONE | S_RXR, C_INTD | C_INTR);
     }
 
     while(count < size && REGS_I2C->status & S_RXD) {
@@ -66,6 +101,8 @@ i2c_status i2c_send(u8 address, u8 *buffer, u32 size){
             REGS_I2C->fifo = *buffer++;
             count++;
         }
+
+        i2c_wait(count < size ? S_DONE | S_TXW : S_DONE, count < size ? C_INTD | C_INTT : C_INTD);
     }
 
     reg32 status = REGS_I2C->status;
@@ -0,0 +1,177 @@
+#include "ipi.h"
+#include "smp.h"
+#include "arch_timer.h"
+#include "printf.h"
+#include "percpu.h"
+#include "irq.h"
+#include "softirq.h"
+#include "peripherals/local.h"
+
+typedef struct {
+    ipi_func func;
+    void *arg;
+    volatile bool pending;
+} ipi_call_slot;
+
+//one slot per (target, sender) pair, senders never share a slot so no lock is needed
+static ipi_call_slot call_slots[NUM_CORES][NUM_CORES];
+static DEFINE_PER_CPU(bool, need_resched);
+static DEFINE_PER_CPU(ipi_stats, stats);
+static DEFINE_PER_CPU(u32, calls_pending);  //senders whose slot waits for the softirq
+
+static void handle_ipi(u32 irq, void *ctx);
+static void ipi_call_softirq();
+
+//every core registers the same handlers, the table entries are shared
+void ipi_init_core() {
+    u32 core = cpu_id();
+
+    open_softirq(SOFTIRQ_IPI_CALL, ipi_call_softirq);
+    irq_register(IRQ_LOCAL_MAILBOX(IPI_MAILBOX), handle_ipi, NULL);
+
+    REGS_LOCAL->mailbox_rdclr[core][IPI_MAILBOX] = 0xFFFFFFFF;
+    REGS_LOCAL->core_mailbox_int_ctrl[core] |= MAILBOX_IRQ_ENABLE(IPI_MAILBOX);
+}
+
+void ipi_send(u32 core_mask, u32 message) {
+    ipi_stats *local = this_cpu_ptr(&stats);
+
+    //make payload writes visible before the remote core sees the mailbox bit
+    asm volatile("dsb sy");
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        if (core_mask & (1 << core)) {
+            REGS_LOCAL->mailbox_set[core][IPI_MAILBOX] = message;
+            local->sent++;
+        }
+    }
+}
+
+void ipi_call(u32 core_mask, ipi_func func, void *arg, bool wait) {
+    u32 self = cpu_id();
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        if (!(core_mask & (1 << core))) {
+            continue;
+        }
+
+        if (core == self) {
+            func(arg);
+            continue;
+        }
+
+        ipi_call_slot *slot = &call_slots[core][self];
+
+        //previous call to this core has to be consumed first
+        while(slot->pending) ;
+
+        slot->func = func;
+        slot->arg = arg;
+        slot->pending = true;
+
+        ipi_send(1 << core, IPI_CALL_BIT(self));
+    }
+
+    if (!wait) {
+        return;
+    }
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        if (core != self && (core_mask & (1 << core))) {
+            while(call_slots[core][self].pending) {
+                asm volatile("wfe");
+            }
+        }
+    }
+}
+
+//the calls can run for a whole frame (render_tiles, the latency loads), so they go to
+//a softirq instead of holding off this core's interrupts
+static void handle_ipi(u32 irq, void *ctx) {
+    u32 core = cpu_id();
+    u32 messages = REGS_LOCAL->mailbox_rdclr[core][IPI_MAILBOX];
+    u32 calls = messages & (IPI_CALL_BIT(NUM_CORES) - 1);
+
+    REGS_LOCAL->mailbox_rdclr[core][IPI_MAILBOX] = messages;
+    this_cpu_ptr(&stats)->received++;
+
+    if (calls) {
+        __atomic_or_fetch(this_cpu_ptr(&calls_pending), calls, __ATOMIC_RELAXED);
+        raise_softirq(SOFTIRQ_IPI_CALL);
+    }
+
+    if (messages & IPI_RESCHEDULE) {
+        this_cpu(need_resched) = true;
+    }
+
+    //IPI_WAKEUP has no payload, taking the interrupt already got the core out of WFI
+}
+
+//a slot stays pending until its function has returned, that is what ipi_call waits on
+static void ipi_call_softirq() {
+    u32 core = cpu_id();
+    u32 senders = __atomic_exchange_n(this_cpu_ptr(&calls_pending), 0, __ATOMIC_ACQUIRE);
+    ipi_stats *local = this_cpu_ptr(&stats);
+
+    while(senders) {
+        u32 sender = __builtin_ctz(senders);
+        ipi_call_slot *slot = &call_slots[core][sender];
+
+        senders &= senders - 1;
+
+        slot->func(slot->arg);
+        local->calls++;
+
+        asm volatile("dmb sy");
+        slot->pending = false;
+        asm volatile("dsb sy; sev");
+    }
+}
+
+bool ipi_need_resched() {
+    bool *flag = this_cpu_ptr(&need_resched);
+    bool resched = *flag;
+
+    *flag = false;
+
+    return resched;
+}
+
+ipi_stats *ipi_get_stats(u32 core) {
+    return per_cpu_ptr(&stats, core);
+}
+
+static void ipi_latency_probe(void *arg) {
+    *(volatile u64 *)arg = clock_ns();
+}
+
+//round trip of an IPI into an idle (WFI) core, sender timestamp -> remote handler
+void ipi_latency_test(u32 iterations) {
+    printf("IPI wakeup latency (%d iterations):\n", iterations);
+
+    for (u32 core=1; core<NUM_CORES; core++) {
+        if (!cpu_is_online(core)) {
+            continue;
+        }
+
+        u64 min = ~0ULL;
+        u64 max = 0;
+        u64 total = 0;
+
+        for (u32 i=0; i<iterations; i++) {
+            volatile u64 woke = 0;
+            u64 sent = clock_ns();
+
+            ipi_call(1 << core, ipi_latency_probe, (void *)&woke, true);
+
+            u64 delta = woke - sent;
+
+            if (delta < min) min = delta;
+            if (delta > max) max = delta;
+            total += delta;
+        }
+
+        printf("\tcore %d: min %d ns avg %d ns max %d ns\n", core,
+            (u32)min, (u32)(total / iterations), (u32)max);
+    }
+}
@@ -2,9 +2,16 @@
 #include "printf.h"
 #include "entry.h"
 #include "peripherals/irq.h"
-#include "peripherals/aux.h"
-#include "Uart/mini_uart.h"
-#include "timer.h"
+#include "smp.h"
+#include "peripherals/local.h"
+#include "irq.h"
+#include "percpu.h"
+#include "cycles.h"
+#include "spinlock.h"
+#include "fpsimd.h"
+#include "softirq.h"
+#include "arch_timer.h"
+#include "log.h"
 
 const char entry_error_messages[16][32] = {
 	"SYNC_INVALID_EL1t",
@@ -33,46 +40,299 @@ void show_invalid_entry_message(u32 type, u64 esr, u64 address) {
         entry_error_messages[type], type, esr, address);
 }
 
-void enable_interrupt_controller() {
+typedef struct {
+    irq_handler handler;
+    void *ctx;
+} irq_desc;
+
+static irq_desc irq_table[NR_IRQS];
+static spinlock irq_table_lock = SPINLOCK_INIT;
+
+//software copy of the controller enables, pending bits are filtered through it
+//(the GPU keeps using sources of its own, e.g. system timer compares 0 and 2)
+static u32 enabled_mask[3];
+
+static DEFINE_PER_CPU(irq_stat, irq_stats[NR_IRQS]);
+static DEFINE_PER_CPU(u32, irq_spurious);
+static DEFINE_PER_CPU(u64, irq_entry_stamp);
+static DEFINE_PER_CPU(irq_frame *, irq_cur_frame);
+
+#define BANK_VC_LO  0
+#define BANK_VC_HI  1
+#define BANK_ARM    2
+
+#define ARM_SOURCES_MASK 0xFF
+
+//VC and ARM sources are enabled in the controller, local ones by their driver per core
+static void irq_controller_set(u32 irq, bool enable) {
+    u32 bank;
+    u32 bit;
+
+    if (irq >= IRQ_LOCAL(0)) {
+        return;
+    } else if (irq >= IRQ_ARM(0)) {
+        bank = BANK_ARM;
+        bit = 1 << (irq - IRQ_ARM(0));
+    } else {
+        bank = irq / 32;
+        bit = 1 << (irq % 32);
+    }
+
+    //enable and disable registers are write-1-to-set/clear, other sources are left alone
+    if (enable) {
+        enabled_mask[bank] |= bit;
+
+    #if RPI_VERSION == 4
+        if (bank == BANK_VC_LO) REGS_IRQ->irq0_enable_0 = bit;
+        if (bank == BANK_VC_HI) REGS_IRQ->irq0_enable_1 = bit;
+        if (bank == BANK_ARM)   REGS_IRQ->irq0_enable_2 = bit;
+    #endif
+
+    #if RPI_VERSION == 3
+        if (bank == BANK_VC_LO) REGS_IRQ->irq0_enable_1 = bit;
+        if (bank == BANK_VC_HI) REGS_IRQ->irq0_enable_2 = bit;
+        if (bank == BANK_ARM)   REGS_IRQ->irq0_enable_0 = bit;
+    #endif
+    } else {
+        enabled_mask[bank] &= ~bit;
+
     #if RPI_VERSION == 4
-        REGS_IRQ->irq0_enable_0 = AUX_IRQ | SYS_TIMER_IRQ_1 | SYS_TIMER_IRQ_3;
+        if (bank == BANK_VC_LO) REGS_IRQ->irq0_disable_0 = bit;
+        if (bank == BANK_VC_HI) REGS_IRQ->irq0_disable_1 = bit;
+        if (bank == BANK_ARM)   REGS_IRQ->irq0_disable_2 = bit;
     #endif
 
     #if RPI_VERSION == 3
-        REGS_IRQ->irq0_enable_1 = AUX_IRQ| SYS_TIMER_IRQ_1 | SYS_TIMER_IRQ_3;
+        if (bank == BANK_VC_LO) REGS_IRQ->irq0_disable_1 = bit;
+        if (bank == BANK_VC_HI) REGS_IRQ->irq0_disable_2 = bit;
+        if (bank == BANK_ARM)   REGS_IRQ->irq0_disable_0 = bit;
     #endif
+    }
+}
+
+//installs the handler and enables a VC/ARM source; local sources (timers, mailboxes)
+//are shared by every core and stay enabled or disabled by their driver
+bool irq_register(u32 irq, irq_handler handler, void *ctx) {
+    if (irq >= NR_IRQS || !handler) {
+        return false;
+    }
+
+    u64 flags = spin_lock_irqsave(&irq_table_lock);
+
+    irq_table[irq].ctx = ctx;
+    //ctx has to be visible before another core can see the handler
+    asm volatile("dmb sy");
+    irq_table[irq].handler = handler;
+
+    irq_controller_set(irq, true);
+
+    spin_unlock_irqrestore(&irq_table_lock, flags);
+
+    return true;
+}
+
+void irq_unregister(u32 irq) {
+    if (irq >= NR_IRQS) {
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&irq_table_lock);
+
+    irq_controller_set(irq, false);
+    irq_table[irq].handler = NULL;
+    irq_table[irq].ctx = NULL;
+
+    spin_unlock_irqrestore(&irq_table_lock, flags);
+}
+
+//local sources the table has no handler for, reported once each
+static u32 local_unhandled;
+
+//masks a local source on the calling core only, the others keep their own setting
+static void irq_local_mask(u32 bit) {
+    u32 core = cpu_id();
+
+    if (bit < 4) {
+        REGS_LOCAL->core_timer_int_ctrl[core] &= ~(1U << bit);
+    } else if (bit < 8) {
+        REGS_LOCAL->core_mailbox_int_ctrl[core] &= ~MAILBOX_IRQ_ENABLE(bit - 4);
+    } else if ((1U << bit) == LOCAL_IRQ_PMU) {
+        REGS_LOCAL->pmu_int_routing_clr = 1 << core;
+    } else if ((1U << bit) == LOCAL_IRQ_AXI) {
+        REGS_LOCAL->axi_outstanding_irq &= ~AXI_IRQ_ENABLE;
+    } else if ((1U << bit) == LOCAL_IRQ_LOCAL_TIMER) {
+        REGS_LOCAL->local_timer_control &= ~LOCAL_TIMER_IRQ_ENABLE;
+    }
+
+    if (!(__atomic_fetch_or(&local_unhandled, 1U << bit, __ATOMIC_RELAXED) & (1U << bit))) {
+        log_warn("irq: no handler for local source %d on core %d, masked\n", bit, core);
+    }
+}
+
+static void irq_dispatch(u32 irq) {
+    irq_desc *desc = &irq_table[irq];
+    irq_handler handler = desc->handler;
+
+    if (!handler) {
+        //nobody owns it, keep it from firing again
+        this_cpu(irq_spurious)++;
+
+        if (irq >= IRQ_LOCAL(0)) {
+            irq_local_mask(irq - IRQ_LOCAL(0));
+        } else {
+            irq_controller_set(irq, false);
+        }
+        return;
+    }
+
+    irq_stat *stat = this_cpu_ptr(&irq_stats[irq]);
+    u64 start = cycles_now();
+
+    handler(irq, desc->ctx);
+
+    u64 cycles = cycles_now() - start;
+
+    stat->count++;
+    stat->total_cycles += cycles;
+    if (cycles > stat->max_cycles) stat->max_cycles = cycles;
+}
+
+//highest bit first, one CLZ per pending source
+static void irq_dispatch_bank(u32 pending, u32 base) {
+    while(pending) {
+        u32 bit = 31 - __builtin_clz(pending);
+
+        pending &= ~(1U << bit);
+        irq_dispatch(base + bit);
+    }
 }
 
-void handle_irq() {
-    u32 irq;
+//GPU (ARMC) interrupts are only routed to core 0
+static void handle_gpu_irq() {
+    u32 vc_lo;
+    u32 vc_hi;
+    u32 arm;
 
 #if RPI_VERSION == 4
-    irq = REGS_IRQ->irq0_pending_0;
+    vc_lo = REGS_IRQ->irq0_pending_0;
+    vc_hi = REGS_IRQ->irq0_pending_1;
+    arm = REGS_IRQ->irq0_pending_2;
 #endif
 
 #if RPI_VERSION == 3
-    irq = REGS_IRQ->irq0_pending_1;
+    vc_lo = REGS_IRQ->irq0_pending_1;
+    vc_hi = REGS_IRQ->irq0_pending_2;
+    arm = REGS_IRQ->irq0_pending_0;
 #endif
 
-    while(irq) {
-        if (irq & AUX_IRQ) {
-            irq &= ~AUX_IRQ;
+    irq_dispatch_bank(arm & ARM_SOURCES_MASK & enabled_mask[BANK_ARM], IRQ_ARM(0));
+    irq_dispatch_bank(vc_hi & enabled_mask[BANK_VC_HI], IRQ_VC(32));
+    irq_dispatch_bank(vc_lo & enabled_mask[BANK_VC_LO], IRQ_VC(0));
+}
+
+void handle_irq(irq_frame *frame) {
+    this_cpu(irq_entry_stamp) = arch_counter();
 
-            while((REGS_AUX->mu_iir & 4) == 4) {
-                printf("UART Recv: ");
-                uart_send(uart_recv());
-                printf("\n");
-            }
+    //bottom halves can be interrupted, keep the outer frame for when we return
+    irq_frame *outer = this_cpu(irq_cur_frame);
+    this_cpu(irq_cur_frame) = frame;
+
+    u64 start = cycles_now();
+    u32 source = REGS_LOCAL->core_irq_source[cpu_id()] & LOCAL_SOURCES_MASK;
+
+    fpsimd_irq_enter();
+
+    while(source) {
+        u32 bit = 31 - __builtin_clz(source);
+
+        source &= ~(1U << bit);
+
+        if ((1U << bit) == LOCAL_IRQ_GPU) {
+            handle_gpu_irq();
+        } else {
+            irq_dispatch(IRQ_LOCAL(bit));
         }
-        if (irq & SYS_TIMER_IRQ_1) {
-            irq &= ~SYS_TIMER_IRQ_1;
+    }
+
+    //top halves only: the bottom halves below run with IRQs enabled
+    irqoff_record(cycles_now() - start, (u64)__builtin_return_address(0));
+
+    softirq_irq_exit();
+    fpsimd_irq_exit();
+
+    this_cpu(irq_cur_frame) = outer;
+}
+
+u64 irq_entry_time() {
+    return this_cpu(irq_entry_stamp);
+}
+
+irq_frame *irq_get_frame() {
+    return this_cpu(irq_cur_frame);
+}
+
+irq_stat *irq_get_stat(u32 irq, u32 core) {
+    return per_cpu_ptr(&irq_stats[irq], core);
+}
 
-            handle_timer_1();
+void irq_report() {
+    printf("IRQ statistics:\n");
 
+    for (u32 irq=0; irq<NR_IRQS; irq++) {
+        for (u32 core=0; core<NUM_CORES; core++) {
+            irq_stat *stat = irq_get_stat(irq, core);
+
+            if (!stat->count) {
+                continue;
+            }
+
+            printf("\tirq %d core %d: %d calls, avg %d max %d cycles\n", irq, core,
+                stat->count, (u32)(stat->total_cycles / stat->count), stat->max_cycles);
         }
-        if (irq & SYS_TIMER_IRQ_3) {
-            irq &= ~SYS_TIMER_IRQ_3;
-            handle_timer_3();
+    }
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        if (per_cpu(irq_spurious, core)) {
+            printf("\tcore %d: %d spurious\n", core, per_cpu(irq_spurious, core));
         }
     }
 }
+
+static DEFINE_PER_CPU(u64, irqoff_start);
+static DEFINE_PER_CPU(irqoff_stat, irqoff_stats);
+
+void irqoff_begin() {
+    this_cpu(irqoff_start) = cycles_now();
+}
+
+void irqoff_end() {
+    irqoff_record(cycles_now() - this_cpu(irqoff_start), (u64)__builtin_return_address(0));
+}
+
+void irqoff_record(u64 cycles, u64 site) {
+    irqoff_stat *stat = this_cpu_ptr(&irqoff_stats);
+
+    if (cycles > stat->max_cycles) {
+        stat->max_cycles = cycles;
+        stat->max_site = site;
+    }
+}
+
+irqoff_stat *irqoff_get_stat(u32 core) {
+    return per_cpu_ptr(&irqoff_stats, core);
+}
+
+void irqoff_report() {
+    printf("Worst IRQ-off time:\n");
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        irqoff_stat *stat = irqoff_get_stat(core);
+
+        if (!stat->max_cycles) {
+            continue;
+        }
+
+        printf("\tcore %d: %d ns ending at 0x%x\n", core,
+            (u32)cycles_to_ns(stat->max_cycles), (u32)stat->max_site);
+    }
+}
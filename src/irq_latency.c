@@ -0,0 +1,246 @@
+#include "irq_latency.h"
+#include "irq.h"
+#include "smp.h"
+#include "ipi.h"
+#include "mem.h"
+#include "dma.h"
+#include "printf.h"
+#include "arch_timer.h"
+#include "console.h"
+#include "Graphics/blit.h"
+#include "peripherals/timer.h"
+#include "peripherals/irq.h"
+
+#define LAT_LOAD_BUF_SIZE   (128 * 1024)
+
+//deadlines land 50..305us after arming, far enough that the compare write is never late
+#define LAT_MIN_DELAY_US    50
+#define LAT_DELAY_SPAN_US   256
+
+typedef struct {
+    u64 deadline;           //generic counter value of the compare match
+    u64 entry;
+    u64 handler;
+    volatile bool fired;
+} lat_probe;
+
+static lat_probe probe;
+static lat_hist hists[LAT_STAGES];
+
+static const char *stage_names[LAT_STAGES] = {
+    "entry",
+    "handler",
+    "return"
+};
+
+static volatile bool load_run = false;
+static u32 load_active = 0;
+static u32 *load_src = NULL;
+static u32 *load_dest = NULL;
+static dma_channel *load_channel = NULL;
+
+static void lat_handler(u32 irq, void *ctx) {
+    probe.handler = arch_counter();
+    probe.entry = irq_entry_time();
+
+    REGS_TIMER->control_status = SYS_TIMER_IRQ_1;
+    probe.fired = true;
+}
+
+//generic counter at a system timer tick edge, both run off the crystal so the
+//mapping holds for the whole sample
+static void lat_sync(u32 *sys, u64 *arch) {
+    u32 t0 = REGS_TIMER->counter_lo;
+    u32 t;
+
+    while((t = REGS_TIMER->counter_lo) == t0) ;
+
+    *arch = arch_counter();
+    *sys = t;
+}
+
+static void lat_hist_add(lat_hist *h, u64 ticks) {
+    u32 ns = (u32)(ticks * ARCH_TIMER_NS_MUL / ARCH_TIMER_NS_DIV);
+    u32 bucket = ns / LAT_BUCKET_NS;
+
+    h->buckets[bucket < LAT_BUCKETS ? bucket : LAT_BUCKETS]++;
+    h->count++;
+    if (ns > h->max_ns) h->max_ns = ns;
+}
+
+//upper edge of the bucket holding the p-th percentile
+static u32 lat_hist_percentile(lat_hist *h, u32 p) {
+    u32 rank = (h->count * p + 99) / 100;
+    u32 seen = 0;
+
+    for (u32 i=0; i<LAT_BUCKETS; i++) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            return (i + 1) * LAT_BUCKET_NS;
+        }
+    }
+
+    return h->max_ns;
+}
+
+//the stages only ever move forward, an entry stamp from before the match means the
+//compare bit was picked up by a handle_irq() that was already running
+static u64 lat_since(u64 stamp) {
+    return stamp > probe.deadline ? stamp - probe.deadline : 0;
+}
+
+//polls the channel, the completion IRQ goes to core 0
+static void lat_load_dma(void *arg) {
+    while(load_run) {
+        dma_setup_mem_copy(load_channel, load_dest, load_src, LAT_LOAD_BUF_SIZE, 8);
+        dma_start(load_channel);
+        dma_wait(load_channel);
+    }
+
+    __atomic_sub_fetch(&load_active, 1, __ATOMIC_RELEASE);
+}
+
+static void lat_load_uart(void *arg) {
+    while(load_run) {
+        console_send_string("irq latency load 0123456789abcdef\r");
+    }
+
+    console_send_string("\r\n");
+    __atomic_sub_fetch(&load_active, 1, __ATOMIC_RELEASE);
+}
+
+static void lat_load_render(void *arg) {
+    while(load_run) {
+        blit_copy32(load_dest, load_src, LAT_LOAD_BUF_SIZE / 4);
+        blit_fill32(load_src, 0xFF1E1E2E, LAT_LOAD_BUF_SIZE / 4);
+    }
+
+    __atomic_sub_fetch(&load_active, 1, __ATOMIC_RELEASE);
+}
+
+//one secondary per kind of load, they spin in the IPI call softirq until load_run drops
+static void lat_load_start(u32 load) {
+    static const ipi_func loaders[] = { lat_load_dma, lat_load_uart, lat_load_render };
+
+    if (!load_src) {
+        load_src = allocate_memory(LAT_LOAD_BUF_SIZE);
+        load_dest = allocate_memory(LAT_LOAD_BUF_SIZE);
+        load_channel = dma_open_channel(CT_NORMAL);
+    }
+
+    load_run = true;
+
+    for (u32 i=0; i<3; i++) {
+        u32 core = 1 + i;
+
+        if (!(load & (1 << i))) {
+            continue;
+        }
+
+        if (!cpu_is_online(core)) {
+            printf("\tcore %d offline, load %d skipped\n", core, i);
+            continue;
+        }
+
+        __atomic_add_fetch(&load_active, 1, __ATOMIC_RELAXED);
+        ipi_call(1 << core, loaders[i], NULL, false);
+    }
+}
+
+static void lat_load_stop() {
+    load_run = false;
+    asm volatile("dsb sy");
+
+    while(__atomic_load_n(&load_active, __ATOMIC_ACQUIRE)) ;
+}
+
+static void lat_report(u32 samples, u32 load) {
+    printf("IRQ latency (%d samples, load:%s%s%s%s):\n", samples,
+        load ? "" : " none",
+        load & LAT_LOAD_DMA ? " dma" : "",
+        load & LAT_LOAD_UART ? " uart" : "",
+        load & LAT_LOAD_RENDER ? " render" : "");
+
+    if (!hists[LAT_STAGE_ENTRY].count) {
+        printf("\tno samples\n");
+        return;
+    }
+
+    for (u32 s=0; s<LAT_STAGES; s++) {
+        lat_hist *h = &hists[s];
+
+        printf("\t%s: p50 %d ns p99 %d ns max %d ns\n", stage_names[s],
+            lat_hist_percentile(h, 50), lat_hist_percentile(h, 99), h->max_ns);
+    }
+
+    printf("\t    <= ns   entry handler  return\n");
+
+    for (u32 i=0; i<=LAT_BUCKETS; i++) {
+        u32 total = 0;
+
+        for (u32 s=0; s<LAT_STAGES; s++) {
+            total += hists[s].buckets[i];
+        }
+
+        if (!total) {
+            continue;
+        }
+
+        if (i < LAT_BUCKETS) {
+            printf("\t%9d", (i + 1) * LAT_BUCKET_NS);
+        } else {
+            printf("\t     more");
+        }
+
+        printf(" %7d %7d %7d\n", hists[LAT_STAGE_ENTRY].buckets[i],
+            hists[LAT_STAGE_HANDLER].buckets[i], hists[LAT_STAGE_RETURN].buckets[i]);
+    }
+}
+
+//core 0 spins in a tight loop so "return" is the first instruction after the eret
+void irq_latency_test(u32 samples, u32 load) {
+    u32 seed = 2463534242U;
+
+    for (u32 s=0; s<LAT_STAGES; s++) {
+        lat_hist *h = &hists[s];
+
+        for (u32 i=0; i<=LAT_BUCKETS; i++) {
+            h->buckets[i] = 0;
+        }
+        h->count = 0;
+        h->max_ns = 0;
+    }
+
+    irq_register(IRQ_SYS_TIMER(1), lat_handler, NULL);
+    lat_load_start(load);
+
+    for (u32 i=0; i<samples; i++) {
+        u32 sys;
+        u64 arch;
+
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        u32 delay = LAT_MIN_DELAY_US + seed % LAT_DELAY_SPAN_US;
+
+        lat_sync(&sys, &arch);
+
+        probe.fired = false;
+        probe.deadline = arch + (u64)delay * ARCH_TIMER_US_DIV / ARCH_TIMER_US_MUL;
+        REGS_TIMER->compare[1] = sys + delay;
+
+        while(!probe.fired) ;
+
+        u64 back = arch_counter();
+
+        lat_hist_add(&hists[LAT_STAGE_ENTRY], lat_since(probe.entry));
+        lat_hist_add(&hists[LAT_STAGE_HANDLER], lat_since(probe.handler));
+        lat_hist_add(&hists[LAT_STAGE_RETURN], lat_since(back));
+    }
+
+    lat_load_stop();
+    irq_unregister(IRQ_SYS_TIMER(1));
+
+    lat_report(samples, load);
+}
@@ -7,36 +7,78 @@
 #include "timer.h"
 #include "mailbox.h"
 #include "Graphics/compositor.h"
-#include "Uart/mini_uart.h"
+#include "console.h"
 #include "mem.h"
 #include "heap_allocator.h"
+#include "smp.h"
+#include "ipi.h"
+#include "ring_buffer.h"
+#include "percpu.h"
+#include "arch_timer.h"
+#include "cycles.h"
+#include "fiq.h"
+#include "fpsimd.h"
+#include "softirq.h"
+#include "irq_latency.h"
+#include "profiler.h"
+#include "log.h"
+#include "monitor.h"
 
 extern void run_graphics_demo();
 extern void run_uart_demo();
 
-void putc(void *p , char c){
-    if(c == '\n'){
-        uart_send('\r');
+//printf sink: whole runs of text into the console ring, \n expanded to \r\n
+void console_out(void *p, const char *buf, u32 len){
+    u32 start = 0;
+
+    for (u32 i=0; i<len; i++) {
+        if (buf[i] == '\n') {
+            console_write_all((const u8 *)buf + start, i - start);
+            console_write_all((const u8 *)"\r\n", 2);
+            start = i + 1;
+        }
     }
-    
-    uart_send(c);
+
+    console_write_all((const u8 *)buf + start, len - start);
 }
 
 
 u32  get_el();
 
 void kernel_main() {
-   uart_init();
-    init_printf(0,putc);
+    percpu_init();
+    arch_timer_init();
+    pmu_init_core();
+    pmu_calibrate();
+   console_init();
+    init_printf_write(0,console_out);
+    log_init();
     gpio_init_all(GFOutput);
     // uart_send_string("Rasperry PI Bare Metal OS Initializing...\n");
     // gpio_debug();
     printf("Rasperry PI Bare Metal OS Initializing...\n");
     printf ("\nException Level: %d \n",get_el()); 
     irq_init_vectors();
-    enable_interrupt_controller();
+    softirq_init();
+    fiq_init_core();
+    fpsimd_init_core();
     irq_enable(); 
     timer_init(); 
+    mailbox_init();
+    smp_init();
+    arch_timer_test();
+    ipi_latency_test(100);
+    fiq_latency_test(100);
+    irq_latency_test(1000, LAT_LOAD_NONE);
+    irq_latency_test(1000, LAT_LOAD_ALL);
+    ring_benchmark();
+    printf_benchmark();
+    fmt_benchmark();
+    timer_wheel_test(2048, 500);
+    irq_report();
+    softirq_report();
+    irqoff_report();
+    log_report();
     printf("Waiting for 200ms\n");
     timer_sleep(200);
 #if RPI_VERSION == 3
@@ -54,10 +96,6 @@ void kernel_main() {
     printf("UART CLOCK: %d\n", mailbox_clock_rate(CT_UART));
     printf("ARM  CLOCK: %d\n", mailbox_clock_rate(CT_ARM));
 
-    u32 max_temp = 0;
-
-    mailbox_generic_command(RPI_FIRMWARE_GET_MAX_TEMPERATURE, 0, &max_temp);
-
     //Do video...
     // void *p1 = get_free_pages(10);
     // void *p2 = get_free_pages(4);
@@ -68,20 +106,19 @@ void kernel_main() {
     // free_memory(p3);
     // timer_sleep(500);
 
+    prof_start(4000, PROF_MAX_DEPTH);
     page_stress_test();
     heap_stress_test();
+    prof_stop();
+    prof_dump("allocators");
+
+    //ready before the demo, its frame loop polls the monitor too
+    monitor_init();
 
     demo_usage();
 
-    
     while(1) {
-        u32 cur_temp = 0;
-
-        mailbox_generic_command(RPI_FIRMWARE_GET_TEMPERATURE, 0, &cur_temp);
-
-        printf("Cur temp: %dC MAX: %dC\n", cur_temp / 1000, max_temp / 1000);
-
-        timer_sleep(1000);
-    
+        monitor_poll();
+        cpu_idle();
     }
 }
@@ -0,0 +1,309 @@
+#include "log.h"
+#include "smp.h"
+#include "irq.h"
+#include "percpu.h"
+#include "printf.h"
+#include "console.h"
+#include "ring_buffer.h"
+#include "arch_timer.h"
+#include <stdarg.h>
+
+//the largest entry: a text line, or a record with LOG_MAX_ARGS arguments
+#define LOG_ENTRY_MAX LOG_LINE_MAX
+
+//a backlog this big goes out as one DMA transfer instead of through the TX ring
+#define LOG_DMA_MIN 512
+
+//one per core: the core is the only producer (IRQs masked around the write), the
+//single consumer is whoever holds draining
+static spsc_ring *log_rings[NUM_CORES];
+static u32 draining = 0;
+
+#if CONSOLE_DMA_MAX
+//gathered by the drainer, copied out by console_write_dma before it returns
+static u8 dma_buf[CONSOLE_DMA_MAX];
+#endif
+
+static DEFINE_PER_CPU(log_stat, log_stats);
+
+//runtime threshold, can only go below the LOG_LEVEL the calls were compiled with
+static u32 log_level = LOG_LEVEL;
+
+static const char level_tags[] = { 'E', 'W', 'I', 'D' };
+
+typedef struct {
+    char *buf;
+    u32 len;
+} log_line;
+
+//drops what does not fit, \n goes out as \r\n
+static void log_write(void *p, const char *buf, u32 len) {
+    log_line *line = (log_line *)p;
+
+    for (u32 i=0; i<len && line->len < LOG_LINE_MAX; i++) {
+        if (buf[i] == '\n' && line->len < LOG_LINE_MAX - 1) {
+            line->buf[line->len++] = '\r';
+        }
+
+        line->buf[line->len++] = buf[i];
+    }
+}
+
+static void log_format(log_line *line, const char *fmt, ...) {
+    va_list va;
+
+    va_start(va, fmt);
+    tfp_format_write(line, log_write, fmt, va);
+    va_end(va);
+}
+
+void log_init() {
+    for (u32 i=0; i<NUM_CORES; i++) {
+        log_rings[i] = spsc_ring_create();
+    }
+
+    console_set_tx_refill(log_drain);
+}
+
+//whole entries or nothing: the ring publishes a bulk write at once, so an empty ring
+//is always an entry boundary for the drainer
+static void log_queue(u32 core, const u8 *buf, u32 len) {
+    spsc_ring *ring = log_rings[core];
+    u64 flags = irq_save();
+    log_stat *stat = this_cpu_ptr(&log_stats);
+    u32 used = spsc_ring_count(ring);
+    bool kick = used == 0;
+
+    //only the drainer shrinks the count, so the check cannot go stale against us
+    if (used + len > SPSC_RING_SIZE) {
+        stat->dropped++;
+        kick = false;
+    } else {
+        spsc_ring_write(ring, buf, len);
+        stat->lines++;
+        stat->bytes += len;
+    }
+
+    irq_restore(flags);
+
+    //the ring was empty, so the drainer may already have passed it
+    if (kick) {
+        console_tx_kick();
+    }
+}
+
+void log_printf(u32 level, const char *fmt, ...) {
+    char buf[LOG_LINE_MAX];
+    log_line line = { buf, 0 };
+    u32 core = cpu_id();
+    va_list va;
+
+    if (level > log_level) {
+        return;
+    }
+
+    log_format(&line, "[%c%d] ", level_tags[level & 3], core);
+
+    va_start(va, fmt);
+    tfp_format_write(&line, log_write, fmt, va);
+    va_end(va);
+
+    //every entry ends the line, cut or not: the drainer splits the rings on \n
+    if (buf[line.len - 1] != '\n') {
+        if (line.len > LOG_LINE_MAX - 2) {
+            line.len = LOG_LINE_MAX - 2;
+        }
+
+        buf[line.len++] = '\r';
+        buf[line.len++] = '\n';
+    }
+
+    if (!log_rings[core]) {
+        buf[line.len < LOG_LINE_MAX ? line.len : LOG_LINE_MAX - 1] = 0;
+        console_send_string(buf);
+        return;
+    }
+
+    log_queue(core, (u8 *)buf, line.len);
+}
+
+void log_binary(u32 level, const char *fmt, const u32 *args, u32 nargs) {
+    u32 buf[(sizeof(log_record) + LOG_MAX_ARGS * sizeof(u32)) / sizeof(u32)];
+    log_record *rec = (log_record *)buf;
+    u32 core = cpu_id();
+    u32 len = sizeof(log_record) + nargs * sizeof(u32);
+
+    if (level > log_level) {
+        return;
+    }
+
+    rec->sync = LOG_SYNC;
+    rec->info = LOG_RECORD_INFO(core, level, nargs);
+    rec->fmt = (u16)(u64)fmt;
+    rec->stamp = (u32)arch_counter();
+
+    for (u32 i=0; i<nargs; i++) {
+        buf[sizeof(log_record) / sizeof(u32) + i] = args[i];
+    }
+
+    if (!log_rings[core]) {
+        for (u32 i=0; i<len; i++) {
+            console_send(((char *)buf)[i]);
+        }
+        return;
+    }
+
+    log_queue(core, (u8 *)buf, len);
+}
+
+static u32 log_backlog() {
+    u32 bytes = 0;
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        bytes += spsc_ring_count(log_rings[core]);
+    }
+
+    return bytes;
+}
+
+//a whole entry fits the console ring, and no transfer holds the FIFO: its completion
+//runs the refill again
+static bool log_can_drain() {
+#if CONSOLE_DMA_MAX
+    if (console_dma_busy()) {
+        return false;
+    }
+#endif
+
+    return console_tx_free() >= LOG_ENTRY_MAX;
+}
+
+//one whole entry into buf, 0 when the ring is empty. Entries are published whole, so
+//a ring always starts on an entry boundary: a record's size is in its info byte, a
+//text line runs up to its \n
+static u32 log_read_entry(spsc_ring *ring, u8 *buf) {
+    u32 len = 0;
+    u8 c;
+
+    if (!spsc_ring_pop(ring, &c)) {
+        return 0;
+    }
+
+    buf[len++] = c;
+
+    if (c == LOG_SYNC) {
+        spsc_ring_pop(ring, &buf[len++]);
+
+        u32 size = sizeof(log_record) + LOG_RECORD_NARGS(buf[1]) * sizeof(u32);
+
+        return len + spsc_ring_read(ring, buf + len, size - len);
+    }
+
+    while(c != '\n' && len < LOG_ENTRY_MAX && spsc_ring_pop(ring, &c)) {
+        buf[len++] = c;
+    }
+
+    return len;
+}
+
+#if CONSOLE_DMA_MAX
+//the same round-robin as below into dma_buf, then one transfer
+static void log_drain_dma() {
+    u32 len = 0;
+    bool more = true;
+
+    while(more) {
+        more = false;
+
+        for (u32 core=0; core<NUM_CORES && len + LOG_ENTRY_MAX <= CONSOLE_DMA_MAX; core++) {
+            u32 n = log_read_entry(log_rings[core], dma_buf + len);
+
+            len += n;
+            more |= n != 0;
+        }
+
+        more &= len + LOG_ENTRY_MAX <= CONSOLE_DMA_MAX;
+    }
+
+    //lost a race for the channel, the entries are already off the rings
+    if (!console_write_dma(dma_buf, len)) {
+        console_write_all(dma_buf, len);
+    }
+}
+#endif
+
+//one entry per core per round, a chatty core cannot starve the others. Only with
+//room for a whole entry, so none is cut off by a full console ring
+static void log_drain_rings() {
+    u8 buf[LOG_ENTRY_MAX];
+    bool more = true;
+
+#if CONSOLE_DMA_MAX
+    if (log_can_drain() && log_backlog() >= LOG_DMA_MIN) {
+        log_drain_dma();
+        return;
+    }
+#endif
+
+    while(more) {
+        more = false;
+
+        for (u32 core=0; core<NUM_CORES; core++) {
+            if (!log_can_drain()) {
+                return;
+            }
+
+            u32 n = log_read_entry(log_rings[core], buf);
+
+            if (n) {
+                //printf on another core may have taken the room meanwhile, wait that out
+                console_write_all(buf, n);
+                more = true;
+            }
+        }
+    }
+}
+
+void log_drain() {
+    if (!log_rings[0]) {
+        return;
+    }
+
+    //a kick that found us busy returned without draining, so look again after letting go
+    do {
+        if (__atomic_exchange_n(&draining, 1, __ATOMIC_ACQUIRE)) {
+            return;
+        }
+
+        log_drain_rings();
+        __atomic_store_n(&draining, 0, __ATOMIC_RELEASE);
+    } while(log_backlog() && log_can_drain());
+}
+
+log_stat *log_get_stat(u32 core) {
+    return per_cpu_ptr(&log_stats, core);
+}
+
+void log_set_level(u32 level) {
+    log_level = level;
+}
+
+u32 log_get_level() {
+    return log_level;
+}
+
+void log_report() {
+    printf("Log (level %d of %d, %d byte rings):\n", log_level, LOG_LEVEL, SPSC_RING_SIZE);
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        log_stat *stat = log_get_stat(core);
+
+        if (!cpu_is_online(core)) {
+            continue;
+        }
+
+        printf("\tcore %d: %d lines %d bytes %d dropped, %d queued\n", core,
+            stat->lines, stat->bytes, stat->dropped,
+            log_rings[core] ? spsc_ring_count(log_rings[core]) : 0);
+    }
+}
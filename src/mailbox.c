@@ -1,7 +1,11 @@
 #include <mailbox.h>
 #include <peripherals/base.h>
 #include "printf.h"
+#include "log.h"
 #include <mem.h>
+#include <mm.h>
+#include <irq.h>
+#include <wait.h>
 
 
 typedef struct {
@@ -27,6 +31,11 @@ static u32 property_data[8192] __attribute__((aligned(16)));
 #define MAIL_EMPTY 0x40000000
 #define MAIL_FULL  0x80000000
 
+#define MAIL_IRQ_DATA 0x1 // config: interrupt while the read FIFO holds data
+
+static wait_queue mailbox_wq = WAIT_QUEUE_INIT;
+static bool mailbox_irq_ready = false;
+
 #define MAIL_POWER    0x0 // Mailbox Channel 0: Power Management Interface
 #define MAIL_FB       0x1 // Mailbox Channel 1: Frame Buffer
 #define MAIL_VUART    0x2 // Mailbox Channel 2: Virtual UART
@@ -43,9 +52,35 @@ static void mailbox_write(u8 channel, u32 data) {
     MBX()->write = (data & 0xFFFFFFF0 | (channel & 0xF));
 }
 
+//level triggered: mask at the mailbox until the next waiter re-arms it
+static void handle_mailbox_irq(u32 irq, void *ctx) {
+    MBX()->config &= ~MAIL_IRQ_DATA;
+    wake_up_all(&mailbox_wq);
+}
+
+//until this runs mailbox_read polls
+void mailbox_init() {
+    irq_register(IRQ_ARM_MAILBOX, handle_mailbox_irq, NULL);
+    mailbox_irq_ready = true;
+}
+
+static bool mailbox_has_data() {
+    if (!(MBX()->status & MAIL_EMPTY)) {
+        return true;
+    }
+
+    MBX()->config |= MAIL_IRQ_DATA;
+
+    return !(MBX()->status & MAIL_EMPTY);
+}
+
 static u32 mailbox_read(u8 channel) {
     while(true) {
-        while(MBX()->status & MAIL_EMPTY) ;
+        if (!mailbox_irq_ready || irq_disabled()) {
+            while(MBX()->status & MAIL_EMPTY) ;
+        } else {
+            wait_event(&mailbox_wq, mailbox_has_data());
+        }
 
         u32 data = MBX()->read;
 
@@ -67,10 +102,15 @@ bool mailbox_process(mailbox_tag *tag, u32 tag_size) {
     buff->code = RPI_FIRMWARE_STATUS_REQUEST;
     property_data[(tag_size + 12) / 4 - 1] = RPI_FIRMWARE_PROPERTY_END;
 
+    //property_data sits in the cached kernel image, the VC reads/writes memory directly
+    dcache_clean_invalidate_range((unsigned long)property_data, buffer_size);
+
     mailbox_write(MAIL_TAGS, (u32)(void *)property_data);
 
     int result = mailbox_read(MAIL_TAGS);
 
+    dcache_clean_invalidate_range((unsigned long)property_data, buffer_size);
+
     memcpy(tag, property_data + 2, tag_size);
 
     return true;
@@ -85,7 +125,7 @@ bool mailbox_generic_command(u32 tag_id, u32 id, u32 *value) {
     mbx.value = *value;
 
     if (!mailbox_process((mailbox_tag *)&mbx, sizeof(mbx))) {
-        printf("FAILED TO PROCESS: %X\n", tag_id);
+        log_err("FAILED TO PROCESS: %X\n", tag_id);
         return false;
     }
 
@@ -3,10 +3,25 @@
 #include <mm.h>
 #include <mmu.h>
 #include <printf.h>
+#include <percpu.h>
+#include <spinlock.h>
 
 static u16 mem_map [ PAGING_PAGES ] = {0,};
+static spinlock page_lock = SPINLOCK_INIT;
 
+//pages sitting in a magazine stay marked allocated (1) in mem_map, only the owner changes
+typedef struct {
+    u32 count;
+    void *pages[PAGE_MAGAZINE_SIZE];
+    cache_stats stats;
+} page_magazine;
 
+static DEFINE_PER_CPU(page_magazine, page_mags);
+
+
+
+#define PAGE_ADDR(index) ((void *)(LOW_MEMORY + ((u64)(index) * PAGE_SIZE)))
+#define PAGE_INDEX(addr)  ((((u64)(addr)) - LOW_MEMORY) / PAGE_SIZE)
 
 void *allocate_memory(int bytes) {
     int pages = bytes / PAGE_SIZE;
@@ -15,21 +30,35 @@ void *allocate_memory(int bytes) {
         pages++;
     }
 
+    if (pages == 1) {
+        return get_free_page();
+    }
+
     return get_free_pages(pages);
 }
 
 void free_memory(void *base) {
-    u64 page_num = (((u64)base) - LOW_MEMORY) / PAGE_SIZE;
+    u64 page_num = PAGE_INDEX(base);
     int pages = mem_map[page_num];
 
+    if (pages == 1) {
+        free_page(base);
+        return;
+    }
+
     printf("free_memory at address %X page num: %d pages: %d\n", base, page_num, pages);
 
+    u64 flags = spin_lock_irqsave(&page_lock);
+
     for (int i=0; i<pages; i++) {
         mem_map[page_num + i] = 0;
     }
+
+    spin_unlock_irqrestore(&page_lock, flags);
 }
 
-void *get_free_pages(int num_pages) {
+//called with page_lock held, returns the first page index of the run or -1
+static int find_free_run(int num_pages) {
     int start_index = 0;
     int count = 0;
 
@@ -49,16 +78,146 @@ void *get_free_pages(int num_pages) {
                     mem_map[c + start_index] = 1;
                 }
 
-                void *p = (void *)(LOW_MEMORY + (start_index * PAGE_SIZE));
-
-                printf("get_free_pages returning %d pages starting at %d at address %X\n", count, start_index, p);
-
-                return p;
+                return start_index;
             }
         } else {
             count = 0;
         }
     }
+
+    return -1;
+}
+
+void *get_free_pages(int num_pages) {
+    u64 flags = spin_lock_irqsave(&page_lock);
+    int start_index = find_free_run(num_pages);
+    spin_unlock_irqrestore(&page_lock, flags);
+
+    if (start_index < 0) {
+        printf("get_free_pages: no run of %d pages\n", num_pages);
+        return NULL;
+    }
+
+    void *p = PAGE_ADDR(start_index);
+
+    printf("get_free_pages returning %d pages starting at %d at address %X\n", num_pages, start_index, p);
+
+    return p;
+}
+
+//one pass over mem_map under the lock for a whole batch of single pages
+static void page_magazine_refill(page_magazine *mag) {
+    spin_lock(&page_lock);
+
+    for (int i=0; i<PAGING_PAGES && mag->count < PAGE_MAGAZINE_BATCH; i++) {
+        if (mem_map[i] == 0) {
+            mem_map[i] = 1;
+            mag->pages[mag->count++] = PAGE_ADDR(i);
+        }
+    }
+
+    spin_unlock(&page_lock);
+    mag->stats.refills++;
+}
+
+//hands the oldest (coldest) batch back, the recently freed pages stay local
+static void page_magazine_drain(page_magazine *mag) {
+    spin_lock(&page_lock);
+
+    for (u32 i=0; i<PAGE_MAGAZINE_BATCH; i++) {
+        mem_map[PAGE_INDEX(mag->pages[i])] = 0;
+    }
+
+    spin_unlock(&page_lock);
+
+    mag->count -= PAGE_MAGAZINE_BATCH;
+
+    for (u32 i=0; i<mag->count; i++) {
+        mag->pages[i] = mag->pages[i + PAGE_MAGAZINE_BATCH];
+    }
+
+    mag->stats.drains++;
+}
+
+//single page fast path, only touches this core's magazine unless it runs dry
+void *get_free_page() {
+    u64 flags = irq_save();
+    page_magazine *mag = this_cpu_ptr(&page_mags);
+    void *page = NULL;
+
+    if (mag->count) {
+        mag->stats.hits++;
+    } else {
+        mag->stats.misses++;
+        page_magazine_refill(mag);
+    }
+
+    if (mag->count) {
+        page = mag->pages[--mag->count];
+    }
+
+    irq_restore(flags);
+
+    return page;
+}
+
+void free_page(void *page) {
+    u64 flags = irq_save();
+    page_magazine *mag = this_cpu_ptr(&page_mags);
+
+    if (mag->count == PAGE_MAGAZINE_SIZE) {
+        mag->stats.misses++;
+        page_magazine_drain(mag);
+    } else {
+        mag->stats.hits++;
+    }
+
+    mag->pages[mag->count++] = page;
+
+    irq_restore(flags);
+}
+
+cache_stats *page_cache_stats(u32 core) {
+    return &per_cpu_ptr(&page_mags, core)->stats;
+}
+
+void cache_stats_report(const char *name, cache_stats *(*stats)(u32 core)) {
+    printf("%s cache:\n", name);
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        cache_stats *s = stats(core);
+        u32 total = s->hits + s->misses;
+
+        if (!total) {
+            continue;
+        }
+
+        printf("\tcore %d: %d hits %d misses (%d%%) refills %d drains %d\n", core,
+            s->hits, s->misses, (s->hits * 100) / total, s->refills, s->drains);
+    }
+}
+
+//page occupancy, magazine pages count as used since mem_map still has them allocated
+void mem_report() {
+    u32 used = 0;
+    u32 cached = 0;
+
+    u64 flags = spin_lock_irqsave(&page_lock);
+
+    for (u32 i=0; i<PAGING_PAGES; i++) {
+        if (mem_map[i]) {
+            used++;
+        }
+    }
+
+    spin_unlock_irqrestore(&page_lock, flags);
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        cached += per_cpu_ptr(&page_mags, core)->count;
+    }
+
+    printf("Pages: %d used (%d in magazines) %d free of %d, %d KB free\n", used, cached,
+        PAGING_PAGES - used, PAGING_PAGES, (PAGING_PAGES - used) * (PAGE_SIZE / 1024));
 }
 
 void *memcpy(void *dest, const void *src, u32 n) {
@@ -98,7 +257,15 @@ void page_stress_test()
             p[j] = 0xAA;
     }
 
+    for (int i = 0; i < PAGE_TEST_COUNT; i++) {
+        if (!pages[i])
+            break;
+
+        free_memory(pages[i]);
+    }
+
     printf("Page allocator test PASSED\n");
+    cache_stats_report("Page", page_cache_stats);
 }
 
 
@@ -117,12 +284,15 @@ void page_stress_test()
 #define TD_KERNEL_TABLE_FLAGS      (TD_TABLE | TD_VALID)
 #define TD_KERNEL_BLOCK_FLAGS      (TD_ACCESS | TD_INNER_SHARABLE | TD_KERNEL_PERMS | (MATTR_NORMAL_NC_INDEX << 2) | TD_BLOCK | TD_VALID)
 #define TD_DEVICE_BLOCK_FLAGS      (TD_ACCESS | TD_INNER_SHARABLE | TD_KERNEL_PERMS | (MATTR_DEVICE_nGnRnE_INDEX << 2) | TD_BLOCK | TD_VALID)
+#define TD_CACHED_BLOCK_FLAGS      (TD_ACCESS | TD_INNER_SHARABLE | TD_KERNEL_PERMS | (MATTR_NORMAL_WB_INDEX << 2) | TD_BLOCK | TD_VALID)
 
 #define MATTR_DEVICE_nGnRnE        0x0
 #define MATTR_NORMAL_NC            0x44
+#define MATTR_NORMAL_WB            0xFF
 #define MATTR_DEVICE_nGnRnE_INDEX  0
 #define MATTR_NORMAL_NC_INDEX      1
-#define MAIR_EL1_VAL               ((MATTR_NORMAL_NC << (8 * MATTR_NORMAL_NC_INDEX)) | MATTR_DEVICE_nGnRnE << (8 * MATTR_DEVICE_nGnRnE_INDEX))
+#define MATTR_NORMAL_WB_INDEX      2
+#define MAIR_EL1_VAL               ((MATTR_NORMAL_WB << (8 * MATTR_NORMAL_WB_INDEX)) | (MATTR_NORMAL_NC << (8 * MATTR_NORMAL_NC_INDEX)) | MATTR_DEVICE_nGnRnE << (8 * MATTR_DEVICE_nGnRnE_INDEX))
 
 #define ID_MAP_PAGES           6
 #define ID_MAP_TABLE_SIZE      (ID_MAP_PAGES * PAGE_SIZE)
@@ -157,6 +327,9 @@ void create_block_map(u64 pmd, u64 vstart, u64 vend, u64 pa) {
 
         if (pa >= DEVICE_START) {
             _pa |= TD_DEVICE_BLOCK_FLAGS;
+        } else if (pa < KERNEL_CACHED_END) {
+            //kernel image: DMA/VC buffers live outside it or get explicit maintenance
+            _pa |= TD_CACHED_BLOCK_FLAGS;
         } else {
             _pa |= TD_KERNEL_BLOCK_FLAGS;
         }
@@ -0,0 +1,453 @@
+#include "monitor.h"
+#include "console.h"
+#include "printf.h"
+#include "smp.h"
+#include "ipi.h"
+#include "irq.h"
+#include "softirq.h"
+#include "irq_latency.h"
+#include "mem.h"
+#include "heap_allocator.h"
+#include "dma.h"
+#include "timer.h"
+#include "mailbox.h"
+#include "cycles.h"
+#include "profiler.h"
+#include "log.h"
+#include "Graphics/compositor.h"
+#include "peripherals/pm.h"
+
+#define KEY_CTRL_C  0x03
+#define KEY_BS      0x08
+#define KEY_CTRL_U  0x15
+#define KEY_ESC     0x1B
+#define KEY_DEL     0x7F
+
+#define PERF_DEFAULT_MS     1000
+#define PROF_DEFAULT_HZ     1000
+
+typedef struct {
+    const char *name;
+    const char *args;
+    const char *help;
+    void (*fn)(u32 argc, char **argv);
+} mon_command;
+
+typedef enum {
+    ESC_NONE,
+    ESC_START,      //got ESC
+    ESC_CSI,        //got ESC [
+} esc_state;
+
+static char line[MONITOR_LINE_MAX];
+static char last[MONITOR_LINE_MAX];
+static u32 line_len = 0;
+static esc_state esc = ESC_NONE;
+static bool last_cr = false;
+
+static bool prof_on = false;
+
+static pmu_sample perf_samples[NUM_CORES];
+
+static bool str_eq(const char *a, const char *b) {
+    while(*a && *a == *b) {
+        a++;
+        b++;
+    }
+
+    return *a == *b;
+}
+
+//decimal, or hex with 0x
+static bool parse_u32(const char *s, u32 *out) {
+    u32 base = 10;
+    u32 v = 0;
+
+    if (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s += 2;
+    }
+
+    if (!*s) {
+        return false;
+    }
+
+    for (; *s; s++) {
+        u32 d;
+
+        if (*s >= '0' && *s <= '9') d = *s - '0';
+        else if (base == 16 && *s >= 'a' && *s <= 'f') d = *s - 'a' + 10;
+        else if (base == 16 && *s >= 'A' && *s <= 'F') d = *s - 'A' + 10;
+        else return false;
+
+        v = v * base + d;
+    }
+
+    *out = v;
+    return true;
+}
+
+//"on"/"off", anything else leaves *out alone
+static bool parse_on_off(const char *s, bool *out) {
+    if (str_eq(s, "on")) {
+        *out = true;
+        return true;
+    }
+
+    if (str_eq(s, "off")) {
+        *out = false;
+        return true;
+    }
+
+    return false;
+}
+
+static void cmd_help(u32 argc, char **argv);
+
+static void cmd_mem(u32 argc, char **argv) {
+    mem_report();
+    cache_stats_report("Page", page_cache_stats);
+    cache_stats_report("Heap object", heap_cache_stats);
+}
+
+static void cmd_irq(u32 argc, char **argv) {
+    u32 samples = 1000;
+
+    if (argc > 1 && str_eq(argv[1], "lat")) {
+        if (argc > 2 && !parse_u32(argv[2], &samples)) {
+            printf("irq lat: bad sample count '%s'\n", argv[2]);
+            return;
+        }
+
+        irq_latency_test(samples, LAT_LOAD_NONE);
+        return;
+    }
+
+    irq_report();
+    softirq_report();
+    irqoff_report();
+}
+
+static void cmd_fb(u32 argc, char **argv) {
+    u32 frame_us = video_get_frame_time_us();
+
+    printf("Framebuffer: %d frames, last %d us (%d cycles, %d fps)\n", video_get_frame_count(),
+        frame_us, (u32)video_get_frame_cycles(), frame_us ? 1000000 / frame_us : 0);
+    printf("\trender cores %d, copy by %s\n", video_get_render_cores(), video_get_dma() ? "DMA" : "CPU");
+}
+
+static void cmd_cores(u32 argc, char **argv) {
+    u32 cores;
+
+    if (argc < 2 || !parse_u32(argv[1], &cores) || cores < 1 || cores > NUM_CORES) {
+        printf("usage: cores <1-%d>\n", NUM_CORES);
+        return;
+    }
+
+    video_set_render_cores(cores);
+    video_mark_dirty();
+}
+
+static void cmd_dma(u32 argc, char **argv) {
+    bool on;
+
+    if (argc < 2) {
+        dma_report();
+        return;
+    }
+
+    if (!parse_on_off(argv[1], &on)) {
+        printf("usage: dma [on|off]\n");
+        return;
+    }
+
+    video_set_dma(on);
+    printf("framebuffer copy by %s\n", on ? "DMA" : "CPU");
+}
+
+static void cmd_clock(u32 argc, char **argv) {
+    static const char *names[] = { "EMMC", "UART", "ARM", "CORE" };
+    static const clock_type clocks[] = { CT_EMMC, CT_UART, CT_ARM, CT_CORE };
+    u32 temp = 0;
+    u32 max_temp = 0;
+
+    printf("Clocks:\n");
+
+    for (u32 i=0; i<4; i++) {
+        u32 rate = mailbox_clock_rate(clocks[i]);
+
+        printf("\t%s: %d Hz (%d MHz)\n", names[i], rate, rate / 1000000);
+    }
+
+    printf("\tCPU counter: %d cycles/us\n", cpu_cycles_per_us());
+
+    if (mailbox_generic_command(RPI_FIRMWARE_GET_TEMPERATURE, 0, &temp)
+            && mailbox_generic_command(RPI_FIRMWARE_GET_MAX_TEMPERATURE, 0, &max_temp)) {
+        printf("\tSoC temp: %dC, max %dC\n", temp / 1000, max_temp / 1000);
+    }
+}
+
+static void perf_start(void *arg) {
+    pmu_events_start(&perf_samples[cpu_id()]);
+}
+
+static void perf_read(void *arg) {
+    pmu_events_read(&perf_samples[cpu_id()]);
+}
+
+static void cmd_perf(u32 argc, char **argv) {
+    u32 ms = PERF_DEFAULT_MS;
+    u32 cores = cpu_online_mask();
+
+    if (argc > 1 && str_eq(argv[1], "reset")) {
+        cycle_report_reset();
+        return;
+    }
+
+    if (argc > 1 && (!parse_u32(argv[1], &ms) || !ms)) {
+        printf("usage: perf [ms|reset]\n");
+        return;
+    }
+
+    ipi_call(cores, perf_start, NULL, true);
+    timer_sleep(ms);
+    ipi_call(cores, perf_read, NULL, true);
+
+    printf("PMU over %d ms (cycles stop in WFI):\n", ms);
+    printf("\tcore      cycles       instr   IPC  L1D refill  L2D refill  br mispred\n");
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        pmu_sample *s = &perf_samples[core];
+        u32 ipc;
+
+        if (!(cores & (1 << core))) {
+            continue;
+        }
+
+        ipc = s->cycles ? (u32)((u64)s->events[0] * 100 / s->cycles) : 0;
+
+        printf("\t%4d %11d %11d %2d.%02d %11d %11d %11d\n", core, (u32)s->cycles, s->events[0],
+            ipc / 100, ipc % 100, s->events[1], s->events[2], s->events[3]);
+    }
+
+    cycle_report();
+}
+
+static void cmd_prof(u32 argc, char **argv) {
+    u32 hz = PROF_DEFAULT_HZ;
+    bool on;
+
+    if (argc < 2 || !parse_on_off(argv[1], &on) || (argc > 2 && !parse_u32(argv[2], &hz))) {
+        printf("usage: prof on [hz] | prof off\n");
+        return;
+    }
+
+    if (on == prof_on) {
+        printf("profiler already %s\n", on ? "running" : "stopped");
+        return;
+    }
+
+    prof_on = on;
+
+    if (on) {
+        prof_start(hz, PROF_MAX_DEPTH);
+        printf("profiling at %d Hz, 'prof off' dumps it\n", hz);
+    } else {
+        prof_stop();
+        prof_dump("monitor");
+    }
+}
+
+static void cmd_log(u32 argc, char **argv) {
+    u32 level;
+
+    if (argc < 2) {
+        log_report();
+        return;
+    }
+
+    if (!parse_u32(argv[1], &level) || level > LOG_DEBUG) {
+        printf("usage: log [0-3]   (err warn info debug)\n");
+        return;
+    }
+
+    log_set_level(level);
+
+    if (level > LOG_LEVEL) {
+        printf("built with LOG_LEVEL=%d, higher levels are compiled out\n", LOG_LEVEL);
+    }
+}
+
+//a chainloader installed as kernel8.img comes up next, tools/chainload.py --reboot
+static void cmd_reboot(u32 argc, char **argv) {
+    printf("rebooting\n");
+    console_flush();
+
+    irq_disable();
+    REGS_PM->wdog = PM_PASSWORD | 10;
+    REGS_PM->rstc = PM_PASSWORD | (REGS_PM->rstc & ~PM_RSTC_WRCFG_MASK) | PM_RSTC_WRCFG_FULL_RESET;
+
+    while(1) {
+        asm volatile("wfe");
+    }
+}
+
+static const mon_command commands[] = {
+    { "help",   "",             "this list",                                cmd_help },
+    { "mem",    "",             "page and heap allocator statistics",       cmd_mem },
+    { "irq",    "[lat [n]]",    "per-IRQ counts and cycles, lat: latency test", cmd_irq },
+    { "fb",     "",             "frame count and timing",                   cmd_fb },
+    { "cores",  "<n>",          "render on n cores",                        cmd_cores },
+    { "dma",    "[on|off]",     "channel utilisation, or framebuffer DMA",  cmd_dma },
+    { "clock",  "",             "mailbox clock rates and temperature",      cmd_clock },
+    { "perf",   "[ms|reset]",   "PMU counters per core, cycle scopes",      cmd_perf },
+    { "prof",   "on [hz]|off",  "sampling profiler, off dumps the profile", cmd_prof },
+    { "log",    "[0-3]",        "log statistics, or set the log level",     cmd_log },
+    { "reboot", "",             "watchdog reset",                           cmd_reboot },
+};
+
+#define NUM_COMMANDS (sizeof(commands) / sizeof(commands[0]))
+
+static void cmd_help(u32 argc, char **argv) {
+    for (u32 i=0; i<NUM_COMMANDS; i++) {
+        printf("\t%-6s %-12s %s\n", commands[i].name, commands[i].args, commands[i].help);
+    }
+}
+
+static void prompt() {
+    printf("> ");
+}
+
+//splits the line in place on spaces
+static void execute(char *buf) {
+    char *argv[MONITOR_MAX_ARGS];
+    u32 argc = 0;
+
+    while(*buf && argc < MONITOR_MAX_ARGS) {
+        while(*buf == ' ') *buf++ = 0;
+
+        if (!*buf) {
+            break;
+        }
+
+        argv[argc++] = buf;
+
+        while(*buf && *buf != ' ') buf++;
+    }
+
+    if (!argc) {
+        return;
+    }
+
+    for (u32 i=0; i<NUM_COMMANDS; i++) {
+        if (str_eq(argv[0], commands[i].name)) {
+            commands[i].fn(argc, argv);
+            return;
+        }
+    }
+
+    printf("unknown command '%s', try help\n", argv[0]);
+}
+
+static void erase_line() {
+    while(line_len) {
+        printf("\b \b");
+        line_len--;
+    }
+}
+
+static void recall_last() {
+    erase_line();
+
+    for (line_len=0; last[line_len]; line_len++) {
+        line[line_len] = last[line_len];
+    }
+
+    line[line_len] = 0;
+    printf("%s", line);
+}
+
+static void enter() {
+    printf("\n");
+
+    line[line_len] = 0;
+
+    if (line_len) {
+        for (u32 i=0; i<=line_len; i++) {
+            last[i] = line[i];
+        }
+    }
+
+    line_len = 0;
+    execute(line);
+    prompt();
+}
+
+static void key(char c) {
+    //only ESC [ A (up) is acted on, the rest of a sequence is swallowed
+    if (esc == ESC_START) {
+        esc = c == '[' ? ESC_CSI : ESC_NONE;
+        return;
+    }
+
+    if (esc == ESC_CSI) {
+        if (c >= 0x40 && c <= 0x7E) {
+            esc = ESC_NONE;
+
+            if (c == 'A') {
+                recall_last();
+            }
+        }
+        return;
+    }
+
+    //a terminal sending \r\n should not run the line twice
+    if (c == '\n' && last_cr) {
+        last_cr = false;
+        return;
+    }
+
+    last_cr = c == '\r';
+
+    switch (c) {
+        case '\r':
+        case '\n':
+            enter();
+            break;
+        case KEY_BS:
+        case KEY_DEL:
+            if (line_len) {
+                line_len--;
+                printf("\b \b");
+            }
+            break;
+        case KEY_CTRL_U:
+            erase_line();
+            break;
+        case KEY_CTRL_C:
+            line_len = 0;
+            printf("^C\n");
+            prompt();
+            break;
+        case KEY_ESC:
+            esc = ESC_START;
+            break;
+        default:
+            if (c >= ' ' && c < KEY_DEL && line_len < MONITOR_LINE_MAX - 1) {
+                line[line_len++] = c;
+                printf("%c", c);
+            }
+            break;
+    }
+}
+
+void monitor_init() {
+    printf("\nMonitor ready, 'help' lists the commands\n");
+    prompt();
+}
+
+void monitor_poll() {
+    while(console_is_readable()) {
+        key(console_recv());
+    }
+}
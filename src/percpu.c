@@ -0,0 +1,28 @@
+#include "percpu.h"
+#include "mem.h"
+
+//set up by the linker script, the area holds NUM_CORES cache line aligned copies
+extern char percpu_begin[];
+extern char percpu_end[];
+extern char percpu_area[];
+
+u64 percpu_offset[NUM_CORES];
+
+void percpu_init_core(u32 core) {
+    asm volatile("msr tpidr_el1, %0" : : "r"(percpu_offset[core]));
+}
+
+//core 0 only, before any per-CPU access and before the secondaries are released
+void percpu_init() {
+    u32 len = percpu_end - percpu_begin;
+    u32 stride = (len + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        char *copy = percpu_area + core * stride;
+
+        memcpy(copy, percpu_begin, len);
+        percpu_offset[core] = (u64)(copy - percpu_begin);
+    }
+
+    percpu_init_core(0);
+}
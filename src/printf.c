@@ -21,213 +21,345 @@ Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 
 #include "printf.h"
 
-typedef void (*putcf) (void*,char);
-static putcf stdout_putf;
-static void* stdout_putp;
-
-
-#ifdef PRINTF_LONG_SUPPORT
-
-static void uli2a(unsigned long int num, unsigned int base, int uc,char * bf)
-    {
-    int n=0;
-    unsigned int d=1;
-    while (num/d >= base)
-        d*=base;         
-    while (d!=0) {
-        int dgt = num / d;
-        num%=d;
-        d/=base;
-        if (n || dgt>0|| d==0) {
-            *bf++ = dgt+(dgt<10 ? '0' : (uc ? 'A' : 'a')-10);
-            ++n;
-            }
-        }
-    *bf=0;
-    }
+//output is staged here and handed to the sink one chunk at a time
+#define FMT_CHUNK 64
+
+typedef struct {
+    writef write;
+    void *p;
+    unsigned int len;
+    unsigned int total;
+    char buf[FMT_CHUNK];
+} fmt_out;
+
+//adapts a putc style sink (init_printf, tfp_format) to the write interface
+typedef struct {
+    putcf putf;
+    void *putp;
+} putc_sink;
 
-static void li2a (long num, char * bf)
+typedef struct {
+    char *buf;
+    unsigned int size;
+    unsigned int len;
+} str_sink;
+
+static writef stdout_write;
+static void *stdout_p;
+static putc_sink stdout_putc;
+
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+//n / 100 by multiplying with the reciprocal, exact over the whole range
+static inline unsigned int div100_32(unsigned int n)
     {
-    if (num<0) {
-        num=-num;
-        *bf++ = '-';
-        }
-    uli2a(num,10,0,bf);
+    return (unsigned int)(((unsigned long long)n * 1374389535ULL) >> 37);
     }
 
-#endif
+static inline unsigned long long div100_64(unsigned long long n)
+    {
+    return (unsigned long long)(((unsigned __int128)(n >> 2) * 0x28F5C28F5C28F5C3ULL) >> 66);
+    }
 
-static void ui2a(unsigned int num, unsigned int base, int uc,char * bf)
+//digits are written backwards from end, returns the first one
+static char *utoa_dec(char *end, unsigned long long num)
     {
-    int n=0;
-    unsigned int d=1;
-    while (num/d >= base)
-        d*=base;        
-    while (d!=0) {
-        int dgt = num / d;
-        num%= d;
-        d/=base;
-        if (n || dgt>0 || d==0) {
-            *bf++ = dgt+(dgt<10 ? '0' : (uc ? 'A' : 'a')-10);
-            ++n;
-            }
+    //64-bit multiplies only while the value needs them
+    while (num >> 32) {
+        unsigned long long q = div100_64(num);
+        unsigned int r = (unsigned int)(num - q * 100);
+        end -= 2;
+        end[0] = digit_pairs[2 * r];
+        end[1] = digit_pairs[2 * r + 1];
+        num = q;
         }
-    *bf=0;
+
+    unsigned int n = (unsigned int)num;
+
+    while (n >= 100) {
+        unsigned int q = div100_32(n);
+        unsigned int r = n - q * 100;
+        end -= 2;
+        end[0] = digit_pairs[2 * r];
+        end[1] = digit_pairs[2 * r + 1];
+        n = q;
+        }
+
+    if (n >= 10) {
+        end -= 2;
+        end[0] = digit_pairs[2 * n];
+        end[1] = digit_pairs[2 * n + 1];
+        }
+    else
+        *--end = '0' + n;
+
+    return end;
     }
 
-static void i2a (int num, char * bf)
+static char *utoa_hex(char *end, unsigned long long num, int uc)
     {
-    if (num<0) {
-        num=-num;
-        *bf++ = '-';
+    const char *digits = uc ? hex_upper : hex_lower;
+
+    do {
+        *--end = digits[num & 0xF];
+        num >>= 4;
+        } while (num);
+
+    return end;
+    }
+
+static void out_flush(fmt_out *out)
+    {
+    if (out->len) {
+        out->write(out->p, out->buf, out->len);
+        out->len = 0;
         }
-    ui2a(num,10,0,bf);
     }
 
-static int a2d(char ch)
+static void out_put(fmt_out *out, const char *s, unsigned int n)
     {
-    if (ch>='0' && ch<='9') 
-        return ch-'0';
-    else if (ch>='a' && ch<='f')
-        return ch-'a'+10;
-    else if (ch>='A' && ch<='F')
-        return ch-'A'+10;
-    else return -1;
+    out->total += n;
+
+    if (out->len + n > FMT_CHUNK) {
+        out_flush(out);
+
+        //long runs skip the staging buffer
+        if (n >= FMT_CHUNK) {
+            out->write(out->p, s, n);
+            return;
+            }
+        }
+
+    for (unsigned int i = 0; i < n; i++)
+        out->buf[out->len + i] = s[i];
+    out->len += n;
     }
 
-static char a2i(char ch, char** src,int base,int* nump)
+static void out_fill(fmt_out *out, char c, int n)
     {
-    char* p= *src;
-    int num=0;
-    int digit;
-    while ((digit=a2d(ch))>=0) {
-        if (digit>base) break;
-        num=num*base+digit;
-        ch=*p++;
+    out->total += n > 0 ? n : 0;
+
+    while (n-- > 0) {
+        if (out->len == FMT_CHUNK)
+            out_flush(out);
+        out->buf[out->len++] = c;
         }
-    *src=p;
-    *nump=num;
-    return ch;
     }
 
-static void putchw(void* putp,putcf putf,int n, char z, char* bf)
+//one converted field: sign/prefix, then zero or space padding up to width
+static void out_field(fmt_out *out, const char *prefix, const char *s, unsigned int n, int width, char lz, char left)
     {
-    char fc=z? '0' : ' ';
-    char ch;
-    char* p=bf;
-    while (*p++ && n > 0)
-        n--;
-    while (n-- > 0) 
-        putf(putp,fc);
-    while ((ch= *bf++))
-        putf(putp,ch);
+    unsigned int plen = 0;
+    while (prefix[plen])
+        plen++;
+
+    int pad = width - (int)(n + plen);
+
+    if (!left && !lz)
+        out_fill(out, ' ', pad);
+    out_put(out, prefix, plen);
+    if (!left && lz)
+        out_fill(out, '0', pad);
+    out_put(out, s, n);
+    if (left)
+        out_fill(out, ' ', pad);
     }
 
-void tfp_format(void* putp,putcf putf,char *fmt, va_list va)
+unsigned int tfp_format_write(void *p, writef write, const char *fmt, va_list va)
     {
-    char bf[12];
-    
-    char ch;
+    fmt_out out;
+    char bf[24];
+    char *end = bf + sizeof(bf);
+
+    out.write = write;
+    out.p = p;
+    out.len = 0;
+    out.total = 0;
 
+    while (*fmt) {
+        //literal runs go out in one piece
+        const char *run = fmt;
+        while (*fmt && *fmt != '%')
+            fmt++;
+        if (fmt != run)
+            out_put(&out, run, fmt - run);
+        if (!*fmt)
+            break;
+
+        fmt++;
+
+        char lz = 0, left = 0, lng = 0;
+        int w = 0, prec = -1;
+
+        for (;; fmt++) {
+            if (*fmt == '0') lz = 1;
+            else if (*fmt == '-') left = 1;
+            else break;
+            }
 
-    while ((ch=*(fmt++))) {
-        if (ch!='%') 
-            putf(putp,ch);
+        if (*fmt == '*') {
+            w = va_arg(va, int);
+            if (w < 0) {
+                left = 1;
+                w = -w;
+                }
+            fmt++;
+            }
         else {
-            char lz=0;
-#ifdef  PRINTF_LONG_SUPPORT
-            char lng=0;
-#endif
-            int w=0;
-            ch=*(fmt++);
-            if (ch=='0') {
-                ch=*(fmt++);
-                lz=1;
+            while (*fmt >= '0' && *fmt <= '9')
+                w = w * 10 + (*fmt++ - '0');
+            }
+
+        if (*fmt == '.') {
+            fmt++;
+            prec = 0;
+            while (*fmt >= '0' && *fmt <= '9')
+                prec = prec * 10 + (*fmt++ - '0');
+            }
+
+        while (*fmt == 'l' || *fmt == 'z' || *fmt == 'h') {
+            if (*fmt != 'h')
+                lng = 1;
+            fmt++;
+            }
+
+        char ch = *fmt++;
+        char *s;
+
+        switch (ch) {
+            case 0:
+                fmt--;
+                break;
+            case 'd': case 'i': {
+                long long v = lng ? va_arg(va, long long) : va_arg(va, int);
+                unsigned long long u = v < 0 ? 0 - (unsigned long long)v : (unsigned long long)v;
+                s = utoa_dec(end, u);
+                out_field(&out, v < 0 ? "-" : "", s, end - s, w, lz, left);
+                break;
                 }
-            if (ch>='0' && ch<='9') {
-                ch=a2i(ch,&fmt,10,&w);
+            case 'u': {
+                unsigned long long u = lng ? va_arg(va, unsigned long long) : va_arg(va, unsigned int);
+                s = utoa_dec(end, u);
+                out_field(&out, "", s, end - s, w, lz, left);
+                break;
                 }
-#ifdef  PRINTF_LONG_SUPPORT
-            if (ch=='l') {
-                ch=*(fmt++);
-                lng=1;
-            }
-#endif
-            switch (ch) {
-                case 0: 
-                    goto abort;
-                case 'u' : {
-#ifdef  PRINTF_LONG_SUPPORT
-                    if (lng)
-                        uli2a(va_arg(va, unsigned long int),10,0,bf);
-                    else
-#endif
-                    ui2a(va_arg(va, unsigned int),10,0,bf);
-                    putchw(putp,putf,w,lz,bf);
-                    break;
-                    }
-                case 'd' :  {
-#ifdef  PRINTF_LONG_SUPPORT
-                    if (lng)
-                        li2a(va_arg(va, unsigned long int),bf);
-                    else
-#endif
-                    i2a(va_arg(va, int),bf);
-                    putchw(putp,putf,w,lz,bf);
-                    break;
-                    }
-                case 'x': case 'X' : 
-#ifdef  PRINTF_LONG_SUPPORT
-                    if (lng)
-                        uli2a(va_arg(va, unsigned long int),16,(ch=='X'),bf);
-                    else
-#endif
-                    ui2a(va_arg(va, unsigned int),16,(ch=='X'),bf);
-                    putchw(putp,putf,w,lz,bf);
-                    break;
-                case 'c' : 
-                    putf(putp,(char)(va_arg(va, int)));
-                    break;
-                case 's' : 
-                    putchw(putp,putf,w,0,va_arg(va, char*));
-                    break;
-                case '%' :
-                    putf(putp,ch);
-                default:
-                    break;
+            case 'x': case 'X': {
+                unsigned long long u = lng ? va_arg(va, unsigned long long) : va_arg(va, unsigned int);
+                s = utoa_hex(end, u, ch == 'X');
+                out_field(&out, "", s, end - s, w, lz, left);
+                break;
+                }
+            case 'p': {
+                unsigned long long u = (unsigned long long)va_arg(va, void *);
+                s = utoa_hex(end, u, 0);
+                out_field(&out, "0x", s, end - s, w, lz, left);
+                break;
+                }
+            case 'c': {
+                char c = (char)va_arg(va, int);
+                out_field(&out, "", &c, 1, w, 0, left);
+                break;
                 }
+            case 's': {
+                s = va_arg(va, char *);
+                if (!s)
+                    s = "(null)";
+                unsigned int n = 0;
+                while (s[n] && (prec < 0 || n < (unsigned int)prec))
+                    n++;
+                out_field(&out, "", s, n, w, 0, left);
+                break;
+                }
+            case '%':
+                out_put(&out, "%", 1);
+                break;
+            default:
+                break;
             }
         }
-    abort:;
+
+    out_flush(&out);
+    return out.total;
+    }
+
+static void putc_write(void *p, const char *buf, unsigned int len)
+    {
+    putc_sink *sink = (putc_sink *)p;
+
+    while (len--)
+        sink->putf(sink->putp, *buf++);
     }
 
+//keeps the terminating 0 in bounds, the rest is counted but dropped
+static void str_write(void *p, const char *buf, unsigned int len)
+    {
+    str_sink *sink = (str_sink *)p;
+
+    while (len-- && sink->len + 1 < sink->size)
+        sink->buf[sink->len++] = *buf++;
+    }
+
+void tfp_format(void* putp,putcf putf,const char *fmt, va_list va)
+    {
+    putc_sink sink = { putf, putp };
+
+    tfp_format_write(&sink, putc_write, fmt, va);
+    }
 
 void init_printf(void* putp,void (*putf) (void*,char))
     {
-    stdout_putf=putf;
-    stdout_putp=putp;
+    stdout_putc.putf = putf;
+    stdout_putc.putp = putp;
+    init_printf_write(&stdout_putc, putc_write);
+    }
+
+void init_printf_write(void *p, writef write)
+    {
+    stdout_write = write;
+    stdout_p = p;
     }
 
-void tfp_printf(char *fmt, ...)
+void tfp_printf(const char *fmt, ...)
     {
     va_list va;
     va_start(va,fmt);
-    tfp_format(stdout_putp,stdout_putf,fmt,va);
+    tfp_format_write(stdout_p,stdout_write,fmt,va);
     va_end(va);
     }
 
-static void putcp(void* p,char c)
+//returns the length the whole output would have had, like the C library
+int tfp_vsnprintf(char *s, unsigned int size, const char *fmt, va_list va)
     {
-    *(*((char**)p))++ = c;
+    str_sink sink = { s, size, 0 };
+    unsigned int total = tfp_format_write(&sink, str_write, fmt, va);
+
+    if (size)
+        s[sink.len] = 0;
+
+    return total;
     }
 
+int tfp_snprintf(char *s, unsigned int size, const char *fmt, ...)
+    {
+    va_list va;
+    va_start(va,fmt);
+    int total = tfp_vsnprintf(s, size, fmt, va);
+    va_end(va);
 
+    return total;
+    }
 
-void tfp_sprintf(char* s,char *fmt, ...)
+//unbounded, prefer snprintf
+void tfp_sprintf(char* s,const char *fmt, ...)
     {
     va_list va;
     va_start(va,fmt);
-    tfp_format(&s,putcp,fmt,va);
-    putcp(&s,0);
+    tfp_vsnprintf(s, ~0U, fmt, va);
     va_end(va);
-    }
\ No newline at end of file
+    }
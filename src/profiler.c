@@ -0,0 +1,220 @@
+#include "profiler.h"
+#include "irq.h"
+#include "ipi.h"
+#include "smp.h"
+#include "mm.h"
+#include "mem.h"
+#include "percpu.h"
+#include "printf.h"
+#include "arch_timer.h"
+
+typedef struct {
+    prof_sample *buf;
+    u32 count;
+    u32 dropped;
+    u64 next;           //deadline of the next tick on the generic counter
+} prof_cpu;
+
+static DEFINE_PER_CPU(prof_cpu, prof);
+
+static volatile bool prof_running = false;
+static u64 prof_period = 0;
+static u32 prof_hz = 0;
+static u32 prof_depth = 0;
+
+//frame records are {previous x29, return address}, only followed while they stay
+//inside the interrupted core's stack and move towards its top
+static u32 prof_backtrace(u64 fp, u64 *callers, u32 max) {
+    u32 core = cpu_id();
+    u64 lo = LOW_MEMORY - (u64)(core + 1) * CORE_STACK_SIZE;
+    u64 hi = LOW_MEMORY - (u64)core * CORE_STACK_SIZE;
+    u32 depth = 0;
+
+    while(depth < max && fp >= lo && fp + 16 <= hi && !(fp & 7)) {
+        u64 *record = (u64 *)fp;
+
+        if (!record[1]) {
+            break;
+        }
+
+        callers[depth++] = record[1];
+
+        if (record[0] <= fp) {
+            break;
+        }
+        fp = record[0];
+    }
+
+    return depth;
+}
+
+static void prof_tick(void *arg) {
+    prof_cpu *p = this_cpu_ptr(&prof);
+    irq_frame *frame = irq_get_frame();
+
+    if (!prof_running) {
+        return;
+    }
+
+    if (p->count < PROF_SAMPLES) {
+        prof_sample *s = &p->buf[p->count++];
+
+        s->pc = frame->elr;
+        s->depth = prof_backtrace(frame->regs[29], s->callers, prof_depth);
+    } else {
+        p->dropped++;
+    }
+
+    //stay on the grid so the rate does not drift with IRQ latency, skip missed ticks
+    u64 now = arch_counter();
+
+    p->next += prof_period;
+    if (p->next <= now) {
+        p->next = now + prof_period;
+    }
+
+    arch_timer_start_at(ARCH_TIMER_VIRT, p->next, prof_tick, NULL);
+}
+
+static void prof_start_core(void *arg) {
+    prof_cpu *p = this_cpu_ptr(&prof);
+
+    p->next = arch_counter() + prof_period;
+    arch_timer_start_at(ARCH_TIMER_VIRT, p->next, prof_tick, NULL);
+}
+
+static void prof_stop_core(void *arg) {
+    arch_timer_stop(ARCH_TIMER_VIRT);
+}
+
+void prof_start(u32 hz, u32 depth) {
+    u32 mask = cpu_online_mask();
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        prof_cpu *p = per_cpu_ptr(&prof, core);
+
+        if (!(mask & (1 << core))) {
+            continue;
+        }
+
+        if (!p->buf) {
+            p->buf = allocate_memory(PROF_SAMPLES * sizeof(prof_sample));
+        }
+        p->count = 0;
+        p->dropped = 0;
+    }
+
+    prof_hz = hz;
+    prof_depth = depth > PROF_MAX_DEPTH ? PROF_MAX_DEPTH : depth;
+    prof_period = arch_counter_freq() / hz;
+    prof_running = true;
+    asm volatile("dsb sy");
+
+    ipi_call(mask, prof_start_core, NULL, true);
+}
+
+void prof_stop() {
+    prof_running = false;
+    asm volatile("dsb sy");
+
+    ipi_call(cpu_online_mask(), prof_stop_core, NULL, true);
+}
+
+//one slot per sample that can exist, the table never fills
+#define PROF_HASH_SIZE (NUM_CORES * PROF_SAMPLES)
+
+typedef struct {
+    prof_sample *sample;
+    u32 count;
+} prof_bucket;
+
+static u32 prof_hash(prof_sample *s) {
+    u64 h = s->pc;
+
+    for (u32 i=0; i<s->depth; i++) {
+        h = h * 0x100000001B3ULL ^ s->callers[i];
+    }
+
+    return (u32)(h ^ (h >> 29)) & (PROF_HASH_SIZE - 1);
+}
+
+static bool prof_same(prof_sample *a, prof_sample *b) {
+    if (a->pc != b->pc || a->depth != b->depth) {
+        return false;
+    }
+
+    for (u32 i=0; i<a->depth; i++) {
+        if (a->callers[i] != b->callers[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//S <count> <pc> [<return address>...], one line per distinct stack over all cores
+void prof_dump(const char *label) {
+    prof_bucket *table = allocate_memory(PROF_HASH_SIZE * sizeof(prof_bucket));
+    u32 total = 0;
+    u32 unique = 0;
+
+    for (u32 i=0; i<PROF_HASH_SIZE; i++) {
+        table[i].sample = NULL;
+        table[i].count = 0;
+    }
+
+    printf("PROFILE BEGIN label=%s hz=%d depth=%d\n", label, prof_hz, prof_depth);
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        prof_cpu *p = per_cpu_ptr(&prof, core);
+
+        if (!p->buf) {
+            continue;
+        }
+
+        printf("C %d %d %d\n", core, p->count, p->dropped);
+
+        for (u32 n=0; n<p->count; n++) {
+            prof_sample *s = &p->buf[n];
+            u32 h = prof_hash(s);
+
+            for (u32 probe=0; probe<PROF_HASH_SIZE; probe++) {
+                prof_bucket *b = &table[(h + probe) & (PROF_HASH_SIZE - 1)];
+
+                if (!b->sample) {
+                    b->sample = s;
+                    b->count = 1;
+                    unique++;
+                    break;
+                }
+
+                if (prof_same(b->sample, s)) {
+                    b->count++;
+                    break;
+                }
+            }
+        }
+
+        total += p->count;
+        p->count = 0;
+        p->dropped = 0;
+    }
+
+    for (u32 i=0; i<PROF_HASH_SIZE; i++) {
+        prof_bucket *b = &table[i];
+
+        if (!b->sample) {
+            continue;
+        }
+
+        printf("S %d %x", b->count, (u32)b->sample->pc);
+        for (u32 d=0; d<b->sample->depth; d++) {
+            printf(" %x", (u32)b->sample->callers[d]);
+        }
+        printf("\n");
+    }
+
+    printf("PROFILE END samples=%d stacks=%d\n", total, unique);
+
+    free_memory(table);
+}
@@ -0,0 +1,123 @@
+#include "smp.h"
+#include "irq.h"
+#include "ipi.h"
+#include "mm.h"
+#include "timer.h"
+#include "printf.h"
+#include "percpu.h"
+#include "arch_timer.h"
+#include "cycles.h"
+#include "fiq.h"
+#include "fpsimd.h"
+#include "softirq.h"
+#include "log.h"
+
+volatile u64 cpu_release_addr[NUM_CORES] = {0,};
+
+static volatile bool online[NUM_CORES] = {true,};
+
+#define CORE_START_TIMEOUT_US 100000
+
+//parks the core until the next interrupt (IPI, timer...)
+//deferred bottom halves and queued log lines first, then WFI unless more work was raised meanwhile
+void cpu_idle() {
+    softirq_run_pending();
+    log_drain();
+
+    u64 flags = irq_save_notrace();
+    if (!softirq_pending()) {
+        asm volatile("dsb sy");
+        asm volatile("wfi");
+    }
+    irq_restore_notrace(flags);
+}
+
+bool cpu_is_online(u32 core) {
+    return core < NUM_CORES && online[core];
+}
+
+u32 cpu_online_mask() {
+    u32 mask = 0;
+
+    for (u32 i=0; i<NUM_CORES; i++) {
+        if (online[i]) {
+            mask |= 1 << i;
+        }
+    }
+
+    return mask;
+}
+
+//first C code run on a secondary after boot.S turned its MMU on
+static void secondary_main(u32 core) {
+    percpu_init_core(core);
+    irq_init_vectors();
+    fiq_init_core();
+    fpsimd_init_core();
+    ipi_init_core();
+    arch_timer_init_core();
+    pmu_init_core();
+    irq_enable();
+
+    online[core] = true;
+    asm volatile("dsb sy");
+
+    while(1) {
+        cpu_idle();
+    }
+}
+
+bool smp_start_core(u32 core, smp_entry_fn entry) {
+    if (core == 0 || core >= NUM_CORES || online[core]) {
+        return false;
+    }
+
+    cpu_release_addr[core] = (u64)entry;
+
+    //the parked core still runs with its MMU (and cache) off
+    dcache_clean_invalidate_range((unsigned long)&cpu_release_addr[core], sizeof(u64));
+    asm volatile("sev");
+
+    u64 start = timer_get_ticks();
+
+    while(!online[core]) {
+        if (timer_get_ticks() - start > CORE_START_TIMEOUT_US) {
+            printf("Core %d failed to start\n", core);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void smp_init() {
+    ipi_init_core();
+
+    for (u32 core=1; core<NUM_CORES; core++) {
+        if (smp_start_core(core, secondary_main)) {
+            printf("Core %d online\n", core);
+        }
+    }
+}
+
+//generation is never reset: a core that has arrived may still be waiting for the
+//previous round to end, and must not see a generation it has already read
+void smp_barrier_init(smp_barrier *barrier, u32 cores) {
+    barrier->arrived = 0;
+    barrier->cores = cores;
+}
+
+void smp_barrier_wait(smp_barrier *barrier) {
+    u32 generation = __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&barrier->arrived, 1, __ATOMIC_ACQ_REL) == barrier->cores) {
+        barrier->arrived = 0;
+        __atomic_store_n(&barrier->generation, generation + 1, __ATOMIC_RELEASE);
+        asm volatile("dsb sy; sev");
+        return;
+    }
+
+    while(__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE) == generation) {
+        asm volatile("wfe");
+    }
+}
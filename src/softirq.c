@@ -0,0 +1,167 @@
+#include "softirq.h"
+#include "irq.h"
+#include "smp.h"
+#include "percpu.h"
+#include "cycles.h"
+#include "printf.h"
+
+typedef struct {
+    u32 pending;
+    bool active;        //a bottom half is running further down this core's stack
+    tasklet *head;
+    tasklet *tail;
+} softirq_cpu;
+
+static softirq_fn softirq_vec[NR_SOFTIRQS];
+
+static DEFINE_PER_CPU(softirq_cpu, softirq_state);
+static DEFINE_PER_CPU(softirq_stats, stats);
+
+static const char *softirq_names[NR_SOFTIRQS] = {
+    "timer",
+    "tasklet",
+    "ipi call"
+};
+
+void open_softirq(softirq_nr nr, softirq_fn fn) {
+    softirq_vec[nr] = fn;
+}
+
+void raise_softirq(softirq_nr nr) {
+    u64 flags = irq_save();
+    this_cpu_ptr(&softirq_state)->pending |= 1 << nr;
+    irq_restore(flags);
+}
+
+bool softirq_pending() {
+    return this_cpu_ptr(&softirq_state)->pending != 0;
+}
+
+//IRQs masked on entry and on return, every round runs with them enabled
+static void softirq_run(u32 rounds) {
+    softirq_cpu *cpu = this_cpu_ptr(&softirq_state);
+    softirq_stats *s = this_cpu_ptr(&stats);
+
+    //an IRQ that came in on top of a bottom half leaves its work to that one
+    if (cpu->active) {
+        return;
+    }
+
+    cpu->active = true;
+
+    while(cpu->pending && rounds--) {
+        u32 pending = cpu->pending;
+
+        cpu->pending = 0;
+        irq_enable();
+
+        while(pending) {
+            u32 nr = __builtin_ctz(pending);
+            u64 start = cycles_now();
+
+            pending &= ~(1U << nr);
+            softirq_vec[nr]();
+
+            u64 cycles = cycles_now() - start;
+
+            s->runs[nr]++;
+            if (cycles > s->max_cycles) s->max_cycles = cycles;
+        }
+
+        irq_disable();
+    }
+
+    cpu->active = false;
+}
+
+void softirq_irq_exit() {
+    softirq_run(SOFTIRQ_RESTARTS);
+
+    if (softirq_pending()) {
+        this_cpu_ptr(&stats)->deferred++;
+    }
+}
+
+void softirq_run_pending() {
+    if (!softirq_pending()) {
+        return;
+    }
+
+    //untracked: softirq_run enables IRQs around every round, and the sections the
+    //bottom halves mask themselves are tracked on their own
+    u64 flags = irq_save_notrace();
+    softirq_run(~0U);
+    irq_restore_notrace(flags);
+}
+
+void tasklet_init(tasklet *t, void (*fn)(void *arg), void *arg) {
+    t->next = NULL;
+    t->fn = fn;
+    t->arg = arg;
+    t->scheduled = false;
+}
+
+void tasklet_schedule(tasklet *t) {
+    if (__atomic_exchange_n(&t->scheduled, true, __ATOMIC_ACQUIRE)) {
+        return;
+    }
+
+    u64 flags = irq_save();
+    softirq_cpu *cpu = this_cpu_ptr(&softirq_state);
+
+    t->next = NULL;
+    if (cpu->head) {
+        cpu->tail->next = t;
+    } else {
+        cpu->head = t;
+    }
+    cpu->tail = t;
+    cpu->pending |= 1 << SOFTIRQ_TASKLET;
+
+    irq_restore(flags);
+}
+
+//the list is taken whole, a tasklet may reschedule itself from fn
+static void tasklet_action() {
+    u64 flags = irq_save();
+    softirq_cpu *cpu = this_cpu_ptr(&softirq_state);
+    tasklet *t = cpu->head;
+
+    cpu->head = NULL;
+    cpu->tail = NULL;
+    irq_restore(flags);
+
+    while(t) {
+        tasklet *next = t->next;
+
+        __atomic_store_n(&t->scheduled, false, __ATOMIC_RELEASE);
+        t->fn(t->arg);
+        t = next;
+    }
+}
+
+void softirq_init() {
+    open_softirq(SOFTIRQ_TASKLET, tasklet_action);
+}
+
+softirq_stats *softirq_get_stats(u32 core) {
+    return per_cpu_ptr(&stats, core);
+}
+
+void softirq_report() {
+    printf("Softirqs:\n");
+
+    for (u32 core=0; core<NUM_CORES; core++) {
+        softirq_stats *s = softirq_get_stats(core);
+
+        if (!cpu_is_online(core)) {
+            continue;
+        }
+
+        printf("\tcore %d:", core);
+        for (u32 nr=0; nr<NR_SOFTIRQS; nr++) {
+            printf(" %s %d", softirq_names[nr], s->runs[nr]);
+        }
+        printf(", deferred %d, longest %d cycles\n", s->deferred, s->max_cycles);
+    }
+}
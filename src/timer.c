@@ -1,45 +1,68 @@
 #include "printf.h"
-#include "peripherals/aux.h"
+#include "timer.h"
+#include "irq.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "wait.h"
+#include "arch_timer.h"
+#include "softirq.h"
 #include "peripherals/timer.h"
 #include "peripherals/irq.h"
 
+//Software timers on a hierarchical (cascading) wheel multiplexed on compare[3].
+//Level n has 64 slots of 64^n jiffies, a timer goes into the lowest level whose
+//range covers it and is moved down when its slot comes up. There is no periodic
+//tick: compare[3] is programmed for the next jiffy at which a level 0 slot
+//expires or a higher slot has to cascade, found with one ctz per level.
 
-const u32 interval_1 = CLOCKHZ;
-u32 cur_val_1 = 0;
+#define WHEEL_LEVELS        4
+#define WHEEL_BITS          6
+#define WHEEL_SLOTS         (1 << WHEEL_BITS)
+#define WHEEL_MASK          (WHEEL_SLOTS - 1)
+#define LEVEL_SHIFT(n)      ((n) * WHEEL_BITS)
 
-const u32 interval_3 = CLOCKHZ / 4;
-u32 cur_val_3 = 0;
+//one jiffy = 8 system timer ticks (us), top level reaches ~134s, later deadlines get re-cascaded
+#define WHEEL_RES_SHIFT     3
+#define TICKS_TO_JIFFY(t)   (((t) + (1 << WHEEL_RES_SHIFT) - 1) >> WHEEL_RES_SHIFT)
 
+//closer than this the compare write could already be in the past, handle it inline
+#define COMPARE_MIN_TICKS   4
+#define COMPARE_MAX_TICKS   0x7FFFFFFF
 
-void timer_init(){
-    cur_val_1 = REGS_TIMER-> counter_lo;
-    cur_val_1 += interval_1;
-    REGS_TIMER->compare[1] = cur_val_1;
+#define NO_EVENT            (~0ULL)
 
-    cur_val_3 = REGS_TIMER->counter_lo;
-    cur_val_3 += interval_3;
-    REGS_TIMER->compare[3] = cur_val_3;
-}
+typedef struct {
+    sw_timer *slots[WHEEL_SLOTS];
+    u64 pending;        //bit per non-empty slot
+} wheel_level;
 
-void handle_timer_1(){
-    cur_val_1 += interval_1;
-    REGS_TIMER->compare[1] = cur_val_1;
-    REGS_TIMER->control_status |= SYS_TIMER_IRQ_1;
+static wheel_level wheel[WHEEL_LEVELS];
+static u64 wheel_clk = 0;      //last processed jiffy
+static u32 wheel_count = 0;
+static spinlock wheel_lock = SPINLOCK_INIT;
+static timer_wheel_stats stats;
+static bool timer_irq_ready = false;
 
-    //printf("timer-1 recvd.\n");
+static void handle_timer_3(u32 irq, void *ctx);
+static void timer_softirq();
 
-}
+//generic counter -> system timer domain, both run off the same crystal so they never drift
+static u64 systimer_offset = 0;
 
-void handle_timer_3(){
-    cur_val_3 += interval_3;
-    REGS_TIMER->compare[3] = cur_val_3;
-    REGS_TIMER->control_status |= SYS_TIMER_IRQ_3;
 
-   // printf("timer-3 recvd.\n");
+void timer_init(){
+    systimer_offset = timer_get_systimer() - clock_us();
+
+    stats.min_late = ~0U;
+    wheel_clk = timer_get_systimer() >> WHEEL_RES_SHIFT;
 
+    open_softirq(SOFTIRQ_TIMER, timer_softirq);
+    irq_register(IRQ_SYS_TIMER(3), handle_timer_3, NULL);
+    timer_irq_ready = true;
 }
 
-u64 timer_get_ticks() {
+//the wheel and compare[3] work in this domain, everyone else uses timer_get_ticks()
+u64 timer_get_systimer() {
     u32 hi = REGS_TIMER->counter_hi;
     u32 lo = REGS_TIMER->counter_lo;
 
@@ -52,11 +75,365 @@ u64 timer_get_ticks() {
     return ((u64)hi << 32) | lo;
 }
 
+//us since boot in the system timer's numbering, without touching the peripheral bus
+u64 timer_get_ticks() {
+    return clock_us() + systimer_offset;
+}
+
+//called with wheel_lock held, earliest is the first jiffy the timer may land on
+static void wheel_enqueue(sw_timer *timer, u64 earliest) {
+    u64 expires = TICKS_TO_JIFFY(timer->deadline);
+
+    if (expires < earliest) {
+        expires = earliest;
+    }
+
+    u64 delta = expires - wheel_clk;
+    u32 level = 0;
+
+    while(level < WHEEL_LEVELS - 1 && delta >= (1ULL << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+
+    if (delta >= (1ULL << LEVEL_SHIFT(WHEEL_LEVELS))) {
+        expires = wheel_clk + (1ULL << LEVEL_SHIFT(WHEEL_LEVELS)) - 1;
+    }
+
+    u32 slot = (expires >> LEVEL_SHIFT(level)) & WHEEL_MASK;
+    sw_timer **head = &wheel[level].slots[slot];
+
+    timer->level = level;
+    timer->slot = slot;
+    timer->next = *head;
+    timer->pprev = head;
+
+    if (*head) {
+        (*head)->pprev = &timer->next;
+    }
+
+    *head = timer;
+    wheel[level].pending |= 1ULL << slot;
+    wheel_count++;
+}
+
+static void wheel_dequeue(sw_timer *timer) {
+    *timer->pprev = timer->next;
+
+    if (timer->next) {
+        timer->next->pprev = timer->pprev;
+    }
+
+    if (!wheel[timer->level].slots[timer->slot]) {
+        wheel[timer->level].pending &= ~(1ULL << timer->slot);
+    }
+
+    timer->pprev = NULL;
+    wheel_count--;
+}
+
+//next jiffy with work: a level 0 slot to run or a higher slot to cascade
+static u64 wheel_next_event() {
+    u64 next = NO_EVENT;
+
+    for (u32 n=0; n<WHEEL_LEVELS; n++) {
+        u64 pending = wheel[n].pending;
+
+        if (!pending) {
+            continue;
+        }
+
+        u64 base = wheel_clk >> LEVEL_SHIFT(n);
+        u32 start = (base + 1) & WHEEL_MASK;
+        u64 rotated = start ? (pending >> start) | (pending << (64 - start)) : pending;
+        u64 at = (base + __builtin_ctzll(rotated) + 1) << LEVEL_SHIFT(n);
+
+        if (at < next) {
+            next = at;
+        }
+    }
+
+    return next;
+}
+
+static void wheel_cascade(u32 level) {
+    u32 slot = (wheel_clk >> LEVEL_SHIFT(level)) & WHEEL_MASK;
+    sw_timer *timer = wheel[level].slots[slot];
+
+    wheel[level].slots[slot] = NULL;
+    wheel[level].pending &= ~(1ULL << slot);
+
+    while(timer) {
+        sw_timer *next = timer->next;
+
+        wheel_count--;
+        //may land in the level 0 slot that runs right after this
+        wheel_enqueue(timer, wheel_clk);
+        timer = next;
+    }
+}
+
+//callbacks run without the lock so they can add or cancel timers
+static void wheel_run_slot(u32 slot, u64 *flags) {
+    sw_timer *timer;
+
+    while((timer = wheel[0].slots[slot])) {
+        u64 now = timer_get_systimer();
+        u32 late = now > timer->deadline ? (u32)(now - timer->deadline) : 0;
+
+        wheel_dequeue(timer);
+
+        stats.expired++;
+        stats.total_late += late;
+        if (late < stats.min_late) stats.min_late = late;
+        if (late > stats.max_late) stats.max_late = late;
+
+        if (timer->period) {
+            //stay on the original grid, skip periods that were missed entirely
+            timer->deadline += timer->period;
+            if (timer->deadline <= now) {
+                timer->deadline = now + timer->period;
+            }
+            wheel_enqueue(timer, wheel_clk + 1);
+        }
+
+        timer_fn fn = timer->fn;
+        void *arg = timer->arg;
+
+        spin_unlock_irqrestore(&wheel_lock, *flags);
+        fn(arg);
+        *flags = spin_lock_irqsave(&wheel_lock);
+    }
+}
+
+static void wheel_advance(u64 target, u64 *flags) {
+    while(wheel_clk < target) {
+        u64 next = wheel_next_event();
+
+        //nothing pending on the way, the skipped slots are all empty
+        if (next > target) {
+            wheel_clk = target;
+            break;
+        }
+
+        wheel_clk = next;
+
+        //top down so cascaded timers can cascade again within the same jiffy
+        for (u32 n=WHEEL_LEVELS-1; n>0; n--) {
+            if (!(wheel_clk & ((1ULL << LEVEL_SHIFT(n)) - 1))) {
+                wheel_cascade(n);
+            }
+        }
+
+        wheel_run_slot(wheel_clk & WHEEL_MASK, flags);
+    }
+}
+
+//false if the next event is already (or almost) due and has to be handled now
+static bool wheel_arm() {
+    u64 next = wheel_next_event();
+
+    if (next == NO_EVENT) {
+        return true;
+    }
+
+    u64 ticks = next << WHEEL_RES_SHIFT;
+    u64 now = timer_get_systimer();
+
+    if (ticks <= now + COMPARE_MIN_TICKS) {
+        return false;
+    }
+
+    //compare[3] only holds the low word, far deadlines just fire early and re-arm
+    if (ticks - now > COMPARE_MAX_TICKS) {
+        ticks = now + COMPARE_MAX_TICKS;
+    }
+
+    REGS_TIMER->compare[3] = (u32)ticks;
+
+    //compare only matches on equality, don't miss a deadline that passed while arming
+    return timer_get_systimer() < ticks;
+}
+
+//outside the IRQ the expiry itself is left to timer_softirq, just make it fire soon
+static void wheel_rearm() {
+    if (wheel_arm()) {
+        return;
+    }
+
+    u64 ticks;
+
+    do {
+        ticks = timer_get_systimer() + COMPARE_MIN_TICKS;
+        REGS_TIMER->compare[3] = (u32)ticks;
+    } while(timer_get_systimer() >= ticks);
+}
+
+//top half: expiry and callbacks are done by the bottom half with IRQs on
+static void handle_timer_3(u32 irq, void *ctx) {
+    REGS_TIMER->control_status = SYS_TIMER_IRQ_3;
+    raise_softirq(SOFTIRQ_TIMER);
+}
+
+//a compare match while this runs only raises the softirq again
+static void timer_softirq() {
+    u64 flags = spin_lock_irqsave(&wheel_lock);
+
+    do {
+        wheel_advance(timer_get_systimer() >> WHEEL_RES_SHIFT, &flags);
+    } while(!wheel_arm());
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+void timer_setup(sw_timer *timer, timer_fn fn, void *arg) {
+    timer->fn = fn;
+    timer->arg = arg;
+    timer->period = 0;
+    timer->pprev = NULL;
+    timer->next = NULL;
+}
+
+static void timer_queue(sw_timer *timer, u64 delay_us, u64 period_us) {
+    u64 flags = spin_lock_irqsave(&wheel_lock);
+
+    if (timer->pprev) {
+        wheel_dequeue(timer);
+    }
+
+    //an empty wheel may be far behind, catching up is free
+    if (!wheel_count) {
+        wheel_clk = timer_get_systimer() >> WHEEL_RES_SHIFT;
+    }
+
+    timer->deadline = timer_get_systimer() + delay_us;
+    timer->period = period_us;
+
+    wheel_enqueue(timer, wheel_clk + 1);
+    wheel_rearm();
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+}
+
+//one-shot, re-adding a pending timer moves it
+void timer_add(sw_timer *timer, u64 delay_us) {
+    timer_queue(timer, delay_us, 0);
+}
+
+//first expiry one period from now
+void timer_add_periodic(sw_timer *timer, u64 period_us) {
+    timer_queue(timer, period_us, period_us);
+}
+
+//the stale compare is left armed, an early interrupt just re-arms
+bool timer_cancel(sw_timer *timer) {
+    u64 flags = spin_lock_irqsave(&wheel_lock);
+    bool pending = timer->pprev != NULL;
+
+    if (pending) {
+        wheel_dequeue(timer);
+    }
+
+    spin_unlock_irqrestore(&wheel_lock, flags);
+
+    return pending;
+}
+
+bool timer_pending(sw_timer *timer) {
+    return timer->pprev != NULL;
+}
+
+static void sleep_wake(void *arg) {
+    wait_entry_wake((wait_entry *)arg);
+}
+
+//sleep in microseconds, the core sits in WFI until the wheel wakes it
+void timer_sleep_us(u64 us) {
+    //without a serviceable timer IRQ on this core there is nothing to wake us
+    if (!timer_irq_ready || irq_disabled()) {
+        u64 deadline = timer_get_ticks() + us;
+        while(timer_get_ticks() < deadline) ;
+        return;
+    }
+
+    sw_timer timer;
+    wait_entry entry;
+
+    entry.core = cpu_id();
+    entry.woken = false;
+
+    timer_setup(&timer, sleep_wake, &entry);
+    timer_add(&timer, us);
+
+    wait_sleep(&entry);
+}
+
 //sleep in milliseconds.
 void timer_sleep(u32 ms) {
+    timer_sleep_us((u64)ms * 1000);
+}
+
+timer_wheel_stats *timer_get_wheel_stats() {
+    return &stats;
+}
+
+void timer_wheel_report() {
+    u32 avg = stats.expired ? (u32)(stats.total_late / stats.expired) : 0;
+
+    printf("Timer wheel: %d pending, %d expired, late min %d us avg %d us max %d us\n",
+        wheel_count, stats.expired, stats.expired ? stats.min_late : 0, avg, stats.max_late);
+}
+
+#define TIMER_TEST_COUNT 2048
+
+static sw_timer test_timers[TIMER_TEST_COUNT];
+static sw_timer test_periodic;
+static volatile u32 test_fired = 0;
+static volatile u32 test_ticks = 0;
+
+static void test_oneshot_fn(void *arg) {
+    test_fired++;
+}
+
+static void test_periodic_fn(void *arg) {
+    test_ticks++;
+}
+
+//spreads count one-shots over 0..span_ms plus one 10ms periodic, reports the expiry jitter
+void timer_wheel_test(u32 count, u32 span_ms) {
+    u32 seed = 12345;
+
+    if (count > TIMER_TEST_COUNT) {
+        count = TIMER_TEST_COUNT;
+    }
+
+    u64 flags = spin_lock_irqsave(&wheel_lock);
+    stats.expired = 0;
+    stats.total_late = 0;
+    stats.min_late = ~0U;
+    stats.max_late = 0;
+    spin_unlock_irqrestore(&wheel_lock, flags);
+
+    test_fired = 0;
+    test_ticks = 0;
+
     u64 start = timer_get_ticks();
 
-    while(timer_get_ticks() < start + (ms * 1000)) {
+    for (u32 i=0; i<count; i++) {
+        seed = seed * 1103515245 + 12345;
 
+        timer_setup(&test_timers[i], test_oneshot_fn, NULL);
+        timer_add(&test_timers[i], (seed >> 8) % ((u64)span_ms * 1000));
     }
-}
\ No newline at end of file
+
+    u64 add_time = timer_get_ticks() - start;
+
+    timer_setup(&test_periodic, test_periodic_fn, NULL);
+    timer_add_periodic(&test_periodic, 10000);
+
+    timer_sleep(span_ms + 10);
+    timer_cancel(&test_periodic);
+
+    printf("Timer wheel test: %d timers added in %d us, %d fired, %d periodic ticks in %d ms\n",
+        count, (u32)add_time, test_fired, test_ticks, span_ms + 10);
+    timer_wheel_report();
+}
@@ -0,0 +1,83 @@
+#include "libcpp/fmt.hpp"
+
+extern "C" {
+    #include "cycles.h"
+    #include "printf.h"
+}
+
+// format_to against snprintf on the strings the demo widgets rebuild every frame.
+// Both format into a buffer, so the numbers are the formatting cost alone.
+
+#define FMT_BENCH_ROUNDS 2000
+
+struct fmt_case {
+    const char *name;
+    u64 printf_cycles;
+    u64 fmt_cycles;
+};
+
+static void fmt_bench_run(fmt_case *c, u32 which) {
+    char buf[128];
+    u64 start = cycles_now();
+
+    for (u32 i = 0; i < FMT_BENCH_ROUNDS; i++) {
+        u32 v = i * 2654435761U;
+
+        switch (which) {
+            case 0:
+                snprintf(buf, sizeof(buf), "FPS: %u", v >> 20);
+                break;
+            case 1:
+                libcpp::format_to<"FPS: {}">(buf, v >> 20);
+                break;
+            case 2:
+                snprintf(buf, sizeof(buf), "[%s] %3d%%", "=========================               ", (int)(v % 101));
+                break;
+            case 3:
+                libcpp::format_to<"[{}] {:3}%">(buf, "=========================               ", (int)(v % 101));
+                break;
+            case 4:
+                snprintf(buf, sizeof(buf), "core %d: %d lines %d bytes %d dropped\n", i & 3, v & 0xFFFF, v >> 12, i);
+                break;
+            case 5:
+                libcpp::format_to<"core {}: {} lines {} bytes {} dropped\n">(buf, i & 3, v & 0xFFFF, v >> 12, i);
+                break;
+            case 6:
+                snprintf(buf, sizeof(buf), "%08x %X", v, v >> 8);
+                break;
+            case 7:
+                libcpp::format_to<"{:08x} {:X}">(buf, v, v >> 8);
+                break;
+        }
+    }
+
+    u64 cycles = (cycles_now() - start) / FMT_BENCH_ROUNDS;
+
+    if (which & 1) {
+        c->fmt_cycles = cycles;
+    } else {
+        c->printf_cycles = cycles;
+    }
+}
+
+extern "C" void fmt_benchmark() {
+    fmt_case cases[] = {
+        { "FPS: {}", 0, 0 },
+        { "progress bar", 0, 0 },
+        { "report line, 4 ints", 0, 0 },
+        { "hex, padded", 0, 0 },
+    };
+    const u32 num_cases = sizeof(cases) / sizeof(cases[0]);
+
+    printf("fmt vs printf (cycles per call, %d calls each):\n", FMT_BENCH_ROUNDS);
+
+    for (u32 c = 0; c < num_cases; c++) {
+        fmt_case *fc = &cases[c];
+
+        fmt_bench_run(fc, 2 * c);
+        fmt_bench_run(fc, 2 * c + 1);
+
+        printf("\t%s: snprintf %d format_to %d (%d.%d x)\n", fc->name, (u32)fc->printf_cycles, (u32)fc->fmt_cycles,
+            (u32)(fc->printf_cycles / fc->fmt_cycles), (u32)(fc->printf_cycles * 10 / fc->fmt_cycles % 10));
+    }
+}
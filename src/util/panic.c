@@ -1,12 +1,16 @@
 #include "libcpp/assert.h"
 #include "printf.h"   // your UART/console printf
 #include "timer.h"    // if you want to halt timer
+#include "console.h"
 #include <stddef.h>
 
 void panic(const char* msg, const char* file, int line) {
     printf("\nKERNEL PANIC!\n");
     printf("%s at %s:%d\n", msg, file, line);
 
+    // TX is interrupt driven, push the message out before parking
+    console_flush();
+
     // Halt the system
     while (1) {
         __asm__ volatile("wfe"); // Wait for event (low-power spin)
@@ -0,0 +1,230 @@
+#include "printf.h"
+#include "cycles.h"
+#include "common.h"
+
+// The printf engine against the tinyprintf one it replaced: per-character putc,
+// repeated division per digit, 32-bit only. Both format into a buffer, so the
+// numbers are the formatting cost alone.
+
+#define PRINTF_BENCH_ROUNDS 2000
+
+// ---- the original engine, as it was (without PRINTF_LONG_SUPPORT) ----
+
+static void legacy_ui2a(unsigned int num, unsigned int base, int uc,char * bf)
+    {
+    int n=0;
+    unsigned int d=1;
+    while (num/d >= base)
+        d*=base;        
+    while (d!=0) {
+        int dgt = num / d;
+        num%= d;
+        d/=base;
+        if (n || dgt>0 || d==0) {
+            *bf++ = dgt+(dgt<10 ? '0' : (uc ? 'A' : 'a')-10);
+            ++n;
+            }
+        }
+    *bf=0;
+    }
+
+static void legacy_i2a (int num, char * bf)
+    {
+    if (num<0) {
+        num=-num;
+        *bf++ = '-';
+        }
+    legacy_ui2a(num,10,0,bf);
+    }
+
+static int legacy_a2d(char ch)
+    {
+    if (ch>='0' && ch<='9') 
+        return ch-'0';
+    else if (ch>='a' && ch<='f')
+        return ch-'a'+10;
+    else if (ch>='A' && ch<='F')
+        return ch-'A'+10;
+    else return -1;
+    }
+
+static char legacy_a2i(char ch, char** src,int base,int* nump)
+    {
+    char* p= *src;
+    int num=0;
+    int digit;
+    while ((digit=legacy_a2d(ch))>=0) {
+        if (digit>base) break;
+        num=num*base+digit;
+        ch=*p++;
+        }
+    *src=p;
+    *nump=num;
+    return ch;
+    }
+
+static void legacy_putchw(void* putp,putcf putf,int n, char z, char* bf)
+    {
+    char fc=z? '0' : ' ';
+    char ch;
+    char* p=bf;
+    while (*p++ && n > 0)
+        n--;
+    while (n-- > 0) 
+        putf(putp,fc);
+    while ((ch= *bf++))
+        putf(putp,ch);
+    }
+
+static void legacy_format(void* putp,putcf putf,char *fmt, va_list va)
+    {
+    char bf[12];
+    
+    char ch;
+
+
+    while ((ch=*(fmt++))) {
+        if (ch!='%') 
+            putf(putp,ch);
+        else {
+            char lz=0;
+            int w=0;
+            ch=*(fmt++);
+            if (ch=='0') {
+                ch=*(fmt++);
+                lz=1;
+                }
+            if (ch>='0' && ch<='9') {
+                ch=legacy_a2i(ch,&fmt,10,&w);
+                }
+            switch (ch) {
+                case 0: 
+                    goto abort;
+                case 'u' : {
+                    legacy_ui2a(va_arg(va, unsigned int),10,0,bf);
+                    legacy_putchw(putp,putf,w,lz,bf);
+                    break;
+                    }
+                case 'd' :  {
+                    legacy_i2a(va_arg(va, int),bf);
+                    legacy_putchw(putp,putf,w,lz,bf);
+                    break;
+                    }
+                case 'x': case 'X' : 
+                    legacy_ui2a(va_arg(va, unsigned int),16,(ch=='X'),bf);
+                    legacy_putchw(putp,putf,w,lz,bf);
+                    break;
+                case 'c' : 
+                    putf(putp,(char)(va_arg(va, int)));
+                    break;
+                case 's' : 
+                    legacy_putchw(putp,putf,w,0,va_arg(va, char*));
+                    break;
+                case '%' :
+                    putf(putp,ch);
+                default:
+                    break;
+                }
+            }
+        }
+    abort:;
+    }
+
+static void legacy_putcp(void* p,char c)
+    {
+    *(*((char**)p))++ = c;
+    }
+
+static void legacy_sprintf(char* s,char *fmt, ...)
+    {
+    va_list va;
+    va_start(va,fmt);
+    legacy_format(&s,legacy_putcp,fmt,va);
+    legacy_putcp(&s,0);
+    va_end(va);
+    }
+
+// ---- benchmark ----
+
+typedef struct {
+    const char *name;
+    u64 legacy;
+    u64 current;
+} bench_case;
+
+static void printf_bench_run(bench_case *c, u32 which) {
+    char buf[128];
+    u64 start = cycles_now();
+
+    for (u32 i=0; i<PRINTF_BENCH_ROUNDS; i++) {
+        u32 v = i * 2654435761U;
+
+        switch (which) {
+            case 0:
+                legacy_sprintf(buf, "%d", v >> 4);
+                break;
+            case 1:
+                snprintf(buf, sizeof(buf), "%d", v >> 4);
+                break;
+            case 2:
+                legacy_sprintf(buf, "%08x %X %u", v, v >> 8, v);
+                break;
+            case 3:
+                snprintf(buf, sizeof(buf), "%08x %X %u", v, v >> 8, v);
+                break;
+            case 4:
+                legacy_sprintf(buf, "core %d: %d lines %d bytes %d dropped\n", i & 3, v & 0xFFFF, v >> 12, i);
+                break;
+            case 5:
+                snprintf(buf, sizeof(buf), "core %d: %d lines %d bytes %d dropped\n", i & 3, v & 0xFFFF, v >> 12, i);
+                break;
+            case 6:
+                legacy_sprintf(buf, "%s = %d", "value", v >> 8);
+                break;
+            case 7:
+                snprintf(buf, sizeof(buf), "%s = %d", "value", v >> 8);
+                break;
+            case 9:
+                snprintf(buf, sizeof(buf), "%llu us", (u64)v * 1000003ULL);
+                break;
+        }
+    }
+
+    u64 cycles = (cycles_now() - start) / PRINTF_BENCH_ROUNDS;
+
+    if (which & 1) {
+        c->current = cycles;
+    } else {
+        c->legacy = cycles;
+    }
+}
+
+void printf_benchmark() {
+    bench_case cases[] = {
+        { "%d", 0, 0 },
+        { "%08x %X %u", 0, 0 },
+        { "report line, 4 ints", 0, 0 },
+        { "%s = %d", 0, 0 },
+        { "%llu (64-bit)", 0, 0 },
+    };
+    const u32 num_cases = sizeof(cases) / sizeof(cases[0]);
+
+    printf("printf engine (cycles per call, %d calls each):\n", PRINTF_BENCH_ROUNDS);
+
+    for (u32 c=0; c<num_cases; c++) {
+        bench_case *bc = &cases[c];
+
+        //the old engine has no 64-bit conversion, there is nothing to compare
+        if (c != 4) {
+            printf_bench_run(bc, 2 * c);
+        }
+        printf_bench_run(bc, 2 * c + 1);
+
+        if (bc->legacy) {
+            printf("\t%s: tinyprintf %d new %d (%d.%d x)\n", bc->name, (u32)bc->legacy, (u32)bc->current,
+                (u32)(bc->legacy / bc->current), (u32)(bc->legacy * 10 / bc->current % 10));
+        } else {
+            printf("\t%s: tinyprintf n/a new %d\n", bc->name, (u32)bc->current);
+        }
+    }
+}
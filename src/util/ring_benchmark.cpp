@@ -0,0 +1,123 @@
+#include "ring_buffer.h"
+#include "libcpp/ring_buffer.hpp"
+
+extern "C" {
+    #include "smp.h"
+    #include "ipi.h"
+    #include "timer.h"
+    #include "printf.h"
+}
+
+using namespace libcpp;
+
+// Throughput of the ring templates for every (producer, consumer) core pair.
+
+#define BENCH_ITEMS (256 * 1024)
+#define BENCH_RING_SIZE 1024
+
+static SpscRing<u64, BENCH_RING_SIZE> bench_spsc;
+static MpmcRing<u64, BENCH_RING_SIZE> bench_mpmc;
+
+template <typename Ring>
+struct BenchRun {
+    Ring *ring;
+    volatile u32 ready;
+    volatile bool go;
+    volatile bool done;
+    volatile u32 errors;
+};
+
+template <typename Ring>
+static void bench_producer(void *arg) {
+    BenchRun<Ring> *run = static_cast<BenchRun<Ring> *>(arg);
+
+    __atomic_fetch_add(&run->ready, 1, __ATOMIC_RELEASE);
+    while (!run->go) ;
+
+    for (u64 i = 0; i < BENCH_ITEMS; i++) {
+        while (!run->ring->push(i)) ;
+    }
+}
+
+template <typename Ring>
+static void bench_consumer(void *arg) {
+    BenchRun<Ring> *run = static_cast<BenchRun<Ring> *>(arg);
+    u32 errors = 0;
+
+    __atomic_fetch_add(&run->ready, 1, __ATOMIC_RELEASE);
+    while (!run->go) ;
+
+    for (u64 i = 0; i < BENCH_ITEMS; i++) {
+        u64 value;
+        while (!run->ring->pop(value)) ;
+        if (value != i) errors++;
+    }
+
+    run->errors = errors;
+    run->done = true;
+}
+
+// returns items per millisecond, 0 if the pair could not run
+template <typename Ring>
+static u32 bench_pair(Ring *ring, u32 producer, u32 consumer, u32 *errors) {
+    // shared with the other cores, so keep it out of the (uncached) stack
+    static BenchRun<Ring> run;
+    run.ring = ring;
+    run.ready = 0;
+    run.go = false;
+    run.done = false;
+    run.errors = 0;
+
+    // the calling core takes its own side of the pair, the other side runs by IPI
+    u32 self = cpu_id();
+    u32 expected = 0;
+
+    if (consumer != self) {
+        ipi_call(1 << consumer, bench_consumer<Ring>, &run, false);
+        expected++;
+    }
+    if (producer != self) {
+        ipi_call(1 << producer, bench_producer<Ring>, &run, false);
+        expected++;
+    }
+
+    while (__atomic_load_n(&run.ready, __ATOMIC_ACQUIRE) < expected) ;
+
+    u64 start = timer_get_ticks();
+    run.go = true;
+
+    if (producer == self) {
+        bench_producer<Ring>(&run);
+    } else if (consumer == self) {
+        bench_consumer<Ring>(&run);
+    }
+
+    while (!run.done) ;
+
+    u64 elapsed = timer_get_ticks() - start;
+    *errors = run.errors;
+
+    return elapsed ? (u32)((u64)BENCH_ITEMS * 1000 / elapsed) : 0;
+}
+
+extern "C" void ring_benchmark() {
+    printf("Ring benchmark: %d items, items/ms per producer->consumer pair\n", BENCH_ITEMS);
+
+    for (u32 p = 0; p < NUM_CORES; p++) {
+        for (u32 c = 0; c < NUM_CORES; c++) {
+            if (p == c || !cpu_is_online(p) || !cpu_is_online(c)) {
+                continue;
+            }
+
+            u32 spsc_errors, mpmc_errors;
+            u32 spsc_rate = bench_pair(&bench_spsc, p, c, &spsc_errors);
+            u32 mpmc_rate = bench_pair(&bench_mpmc, p, c, &mpmc_errors);
+
+            printf("\tcore %d -> core %d: spsc %d mpmc %d", p, c, spsc_rate, mpmc_rate);
+            if (spsc_errors || mpmc_errors) {
+                printf(" ERRORS spsc %d mpmc %d", spsc_errors, mpmc_errors);
+            }
+            printf("\n");
+        }
+    }
+}
@@ -0,0 +1,63 @@
+#include "ring_buffer.h"
+#include "libcpp/ring_buffer.hpp"
+
+using namespace libcpp;
+
+typedef SpscRing<u8, SPSC_RING_SIZE> SpscByteRing;
+typedef MpmcRing<u64, MPMC_RING_SIZE> MpmcMsgRing;
+
+static SpscByteRing spsc_pool[SPSC_RING_POOL];
+static MpmcMsgRing mpmc_pool[MPMC_RING_POOL];
+static u32 spsc_used = 0;
+static u32 mpmc_used = 0;
+
+static SpscByteRing *spsc(spsc_ring *ring) { return reinterpret_cast<SpscByteRing *>(ring); }
+static MpmcMsgRing *mpmc(mpmc_ring *ring) { return reinterpret_cast<MpmcMsgRing *>(ring); }
+
+extern "C" {
+
+spsc_ring *spsc_ring_create() {
+    u32 i = __atomic_fetch_add(&spsc_used, 1, __ATOMIC_RELAXED);
+    if (i >= SPSC_RING_POOL) return nullptr;
+    return reinterpret_cast<spsc_ring *>(&spsc_pool[i]);
+}
+
+bool spsc_ring_push(spsc_ring *ring, u8 value) {
+    return spsc(ring)->push(value);
+}
+
+bool spsc_ring_pop(spsc_ring *ring, u8 *value) {
+    return spsc(ring)->pop(*value);
+}
+
+u32 spsc_ring_write(spsc_ring *ring, const u8 *buf, u32 len) {
+    return spsc(ring)->write(buf, len);
+}
+
+u32 spsc_ring_read(spsc_ring *ring, u8 *buf, u32 len) {
+    return spsc(ring)->read(buf, len);
+}
+
+u32 spsc_ring_count(spsc_ring *ring) {
+    return spsc(ring)->count();
+}
+
+mpmc_ring *mpmc_ring_create() {
+    u32 i = __atomic_fetch_add(&mpmc_used, 1, __ATOMIC_RELAXED);
+    if (i >= MPMC_RING_POOL) return nullptr;
+    return reinterpret_cast<mpmc_ring *>(&mpmc_pool[i]);
+}
+
+bool mpmc_ring_push(mpmc_ring *ring, u64 value) {
+    return mpmc(ring)->push(value);
+}
+
+bool mpmc_ring_pop(mpmc_ring *ring, u64 *value) {
+    return mpmc(ring)->pop(*value);
+}
+
+u32 mpmc_ring_count(mpmc_ring *ring) {
+    return mpmc(ring)->count();
+}
+
+} // extern "C"
@@ -1,11 +1,28 @@
 #include "common.h"
 #include "utils.h"
 #include "Gpio/gpio.h"
-#include "Uart/mini_uart.h"
+#include "console.h"
+#include "arch_timer.h"
+
+//busy waits on the generic counter, independent of clock speed and caches.
+//Resolution is one counter tick (~52ns on the 2837, ~19ns on the 2711), always rounded up.
+void ndelay(u64 ns) {
+    u64 end = arch_counter() + ns_to_arch_ticks(ns) + 1;
+
+    while(arch_counter() < end) ;
+}
+
+void udelay(u64 us) {
+    ndelay(us * 1000);
+}
+
+void mdelay(u64 ms) {
+    ndelay(ms * 1000000);
+}
 
 
 void debug(char *str){
-    uart_send_string(str);
+    console_send_string(str);
     gpio_debug();
 
     delay_seconds(2);
@@ -0,0 +1,183 @@
+#include "wait.h"
+#include "smp.h"
+#include "ipi.h"
+#include "irq.h"
+#include "softirq.h"
+
+void wait_queue_init(wait_queue *wq) {
+    wq->lock = (spinlock)SPINLOCK_INIT;
+    wq->head = NULL;
+}
+
+//called with the queue lock held
+static void wait_enqueue(wait_queue *wq, wait_entry *entry) {
+    entry->core = cpu_id();
+    entry->woken = false;
+    entry->next = NULL;
+
+    //FIFO so wake_up() serves the oldest waiter
+    wait_entry **pos = &wq->head;
+    while(*pos) {
+        pos = &(*pos)->next;
+    }
+    *pos = entry;
+}
+
+void wait_prepare(wait_queue *wq, wait_entry *entry) {
+    u64 flags = spin_lock_irqsave(&wq->lock);
+    wait_enqueue(wq, entry);
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+void wait_sleep(wait_entry *entry) {
+    //nothing can interrupt us, only a remote core can set woken
+    if (irq_disabled()) {
+        while(!entry->woken) ;
+        return;
+    }
+
+    while(!entry->woken) {
+        //the same as cpu_idle: bottom halves left over by handle_irq first
+        softirq_run_pending();
+
+        //mask so the wakeup cannot land between the check and the WFI,
+        //untracked: time in WFI is idle, not IRQ latency
+        u64 flags = irq_save_notrace();
+        if (!entry->woken && !softirq_pending()) {
+            asm volatile("wfi");
+        }
+        irq_restore_notrace(flags);
+    }
+}
+
+//drops the entry if nobody woke it (condition became true on the recheck)
+void wait_finish(wait_queue *wq, wait_entry *entry) {
+    if (entry->woken) {
+        return;
+    }
+
+    u64 flags = spin_lock_irqsave(&wq->lock);
+
+    wait_entry **pos = &wq->head;
+    while(*pos && *pos != entry) {
+        pos = &(*pos)->next;
+    }
+    if (*pos) {
+        *pos = entry->next;
+    }
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+}
+
+//the entry must already be off its queue
+void wait_entry_wake(wait_entry *entry) {
+    u32 core = entry->core;
+
+    //the waiter's stack frame may be gone once woken is seen
+    asm volatile("dmb sy");
+    entry->woken = true;
+
+    if (core != cpu_id()) {
+        ipi_send(1 << core, IPI_WAKEUP);
+    }
+}
+
+static u32 wake_up_n(wait_queue *wq, u32 max) {
+    u32 woken = 0;
+    u64 flags = spin_lock_irqsave(&wq->lock);
+
+    while(wq->head && woken < max) {
+        wait_entry *entry = wq->head;
+
+        wq->head = entry->next;
+        wait_entry_wake(entry);
+        woken++;
+    }
+
+    spin_unlock_irqrestore(&wq->lock, flags);
+
+    return woken;
+}
+
+u32 wake_up(wait_queue *wq) {
+    return wake_up_n(wq, 1);
+}
+
+u32 wake_up_all(wait_queue *wq) {
+    return wake_up_n(wq, ~0U);
+}
+
+void cond_wait(condvar *cv, spinlock *lock) {
+    wait_entry entry;
+
+    wait_prepare(&cv->wq, &entry);
+    spin_unlock(lock);
+
+    wait_sleep(&entry);
+    wait_finish(&cv->wq, &entry);
+
+    spin_lock(lock);
+}
+
+void cond_signal(condvar *cv) {
+    wake_up(&cv->wq);
+}
+
+void cond_broadcast(condvar *cv) {
+    wake_up_all(&cv->wq);
+}
+
+void sem_init(semaphore *sem, u32 count) {
+    wait_queue_init(&sem->wq);
+    sem->count = count;
+}
+
+bool sem_try_down(semaphore *sem) {
+    bool taken = false;
+    u64 flags = spin_lock_irqsave(&sem->wq.lock);
+
+    if (sem->count) {
+        sem->count--;
+        taken = true;
+    }
+
+    spin_unlock_irqrestore(&sem->wq.lock, flags);
+
+    return taken;
+}
+
+void sem_down(semaphore *sem) {
+    while(true) {
+        wait_entry entry;
+        u64 flags = spin_lock_irqsave(&sem->wq.lock);
+
+        if (sem->count) {
+            sem->count--;
+            spin_unlock_irqrestore(&sem->wq.lock, flags);
+            return;
+        }
+
+        //queued under the same lock that sem_up() takes, no lost wakeup
+        wait_enqueue(&sem->wq, &entry);
+        spin_unlock_irqrestore(&sem->wq.lock, flags);
+
+        wait_sleep(&entry);
+        wait_finish(&sem->wq, &entry);
+    }
+}
+
+//safe from IRQ handlers
+void sem_up(semaphore *sem) {
+    u64 flags = spin_lock_irqsave(&sem->wq.lock);
+
+    sem->count++;
+
+    if (sem->wq.head) {
+        wait_entry *entry = sem->wq.head;
+
+        sem->wq.head = entry->next;
+        wait_entry_wake(entry);
+    }
+
+    spin_unlock_irqrestore(&sem->wq.lock, flags);
+}
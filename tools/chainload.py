@@ -0,0 +1,291 @@
+#!/usr/bin/env python3
+"""Push a kernel image to boards running the serial chainloader.
+
+Usage: tools/chainload.py kernel8.img --port /dev/ttyUSB0 [--port ...] [--reboot]
+
+The image is LZ4 compressed (block format) and sent after a header carrying its
+load address, both sizes and the CRC32 of the raw image (chainloader/src/loader.h).
+With several --port options every board is loaded at once. --reboot first types
+"reboot" at the running kernel's monitor, at --console-baud, so a rack of boards
+can be updated without touching them.
+"""
+
+import argparse
+import os
+import select
+import struct
+import sys
+import termios
+import threading
+import time
+import zlib
+
+MAGIC = 0x444C4843          # "CHLD"
+READY = b"chainload: ready"
+ERRORS = {
+    "H": "bad header",
+    "S": "image does not fit",
+    "L": "UART overrun or framing error",
+    "T": "transfer stalled",
+    "D": "corrupt LZ4 data",
+    "C": "CRC mismatch",
+}
+
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+LAST_LITERALS = 5           # a block ends in at least this many literals
+MF_LIMIT = 12               # and no match starts this close to the end
+
+
+def _length(out, n):
+    while n >= 255:
+        out.append(255)
+        n -= 255
+    out.append(n)
+
+
+def _sequence(out, literals, offset=0, match=0):
+    lit = len(literals)
+    ml = match - MIN_MATCH if offset else 0
+
+    out.append((min(lit, 15) << 4) | min(ml, 15))
+    if lit >= 15:
+        _length(out, lit - 15)
+    out += literals
+
+    if offset:
+        out += struct.pack("<H", offset)
+        if ml >= 15:
+            _length(out, ml - 15)
+
+
+def lz4_compress(data):
+    """Greedy LZ4 block compressor, one hash slot per 4-byte prefix."""
+    n = len(data)
+    out = bytearray()
+    table = {}
+    anchor = 0
+    i = 0
+
+    while i < n - MF_LIMIT:
+        key = data[i:i + 4]
+        cand = table.get(key)
+        table[key] = i
+
+        if cand is None or i - cand > MAX_OFFSET:
+            i += 1
+            continue
+
+        match = MIN_MATCH
+        while i + match < n - LAST_LITERALS and data[cand + match] == data[i + match]:
+            match += 1
+
+        while i > anchor and cand > 0 and data[i - 1] == data[cand - 1]:
+            i -= 1
+            cand -= 1
+            match += 1
+
+        _sequence(out, data[anchor:i], i - cand, match)
+        i += match
+        anchor = i
+
+    _sequence(out, data[anchor:])
+    return bytes(out)
+
+
+def lz4_decompress(src, size):
+    """Reference decoder, used to check the compressor before anything is sent."""
+    out = bytearray()
+    i = 0
+
+    while i < len(src):
+        token = src[i]
+        i += 1
+
+        lit = token >> 4
+        if lit == 15:
+            while True:
+                lit += src[i]
+                i += 1
+                if src[i - 1] != 255:
+                    break
+        out += src[i:i + lit]
+        i += lit
+
+        if i == len(src):
+            break
+
+        offset = src[i] | (src[i + 1] << 8)
+        i += 2
+        match = token & 15
+        if match == 15:
+            while True:
+                match += src[i]
+                i += 1
+                if src[i - 1] != 255:
+                    break
+        match += MIN_MATCH
+
+        for _ in range(match):
+            out.append(out[-offset])
+
+    if len(out) != size:
+        raise ValueError("decoded %d bytes, expected %d" % (len(out), size))
+    return bytes(out)
+
+
+def baud_constant(baud):
+    name = "B%d" % baud
+    if not hasattr(termios, name):
+        sys.exit("baud rate %d not supported by termios here" % baud)
+    return getattr(termios, name)
+
+
+class Serial:
+    def __init__(self, port, baud):
+        self.port = port
+        self.fd = os.open(port, os.O_RDWR | os.O_NOCTTY)
+        self.set_baud(baud)
+
+    def set_baud(self, baud):
+        speed = baud_constant(baud)
+        attr = termios.tcgetattr(self.fd)
+
+        # raw 8N1, no flow control
+        attr[0] = 0
+        attr[1] = 0
+        attr[2] = termios.CS8 | termios.CREAD | termios.CLOCAL
+        attr[3] = 0
+        attr[4] = speed
+        attr[5] = speed
+        attr[6][termios.VMIN] = 0
+        attr[6][termios.VTIME] = 0
+
+        termios.tcsetattr(self.fd, termios.TCSANOW, attr)
+        termios.tcflush(self.fd, termios.TCIOFLUSH)
+
+    def write(self, data):
+        view = memoryview(data)
+        while view:
+            select.select([], [self.fd], [])
+            n = os.write(self.fd, view)
+            view = view[n:]
+        termios.tcdrain(self.fd)
+
+    def read_until(self, token, timeout):
+        buf = b""
+        end = time.monotonic() + timeout
+
+        while token not in buf:
+            left = end - time.monotonic()
+            if left <= 0:
+                return None
+            if select.select([self.fd], [], [], left)[0]:
+                buf += os.read(self.fd, 256)
+
+        return buf
+
+    def read_reply(self, timeout):
+        """'OK', or the loader's error description"""
+        buf = b""
+        end = time.monotonic() + timeout
+
+        while True:
+            if b"OK" in buf:
+                return None
+            j = buf.find(b"E")
+            if j >= 0 and len(buf) > j + 1 and chr(buf[j + 1]) in ERRORS:
+                return ERRORS[chr(buf[j + 1])]
+
+            left = end - time.monotonic()
+            if left <= 0:
+                return "no reply"
+            if select.select([self.fd], [], [], left)[0]:
+                buf += os.read(self.fd, 64)
+
+    def close(self):
+        os.close(self.fd)
+
+
+def push(port, args, header, packed, results):
+    tag = "[%s]" % port
+    ser = None
+    try:
+        ser = Serial(port, args.console_baud if args.reboot else args.baud)
+
+        if args.reboot:
+            ser.write(b"\x03\rreboot\r")
+            ser.set_baud(args.baud)
+
+        for attempt in range(1, args.retries + 1):
+            if ser.read_until(READY, args.wait) is None:
+                results[port] = "loader not answering"
+                return
+
+            start = time.monotonic()
+            ser.write(header)
+            err = ser.read_reply(2)
+
+            if not err:
+                ser.write(packed)
+                # time on the wire plus decompression and CRC on the board
+                err = ser.read_reply(len(packed) * 10 / args.baud + 5)
+
+            if not err:
+                print("%s loaded in %.2f s" % (tag, time.monotonic() - start))
+                results[port] = None
+                return
+
+            print("%s attempt %d: %s" % (tag, attempt, err))
+
+        results[port] = err
+    except OSError as e:
+        results[port] = str(e)
+    finally:
+        if ser:
+            ser.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("image", help="kernel8.img")
+    parser.add_argument("--port", action="append", required=True, help="serial device, repeatable")
+    parser.add_argument("--baud", type=int, default=921600, help="LOADER_BAUD of the chainloader")
+    parser.add_argument("--console-baud", type=int, default=115200, help="baud rate of the running kernel")
+    parser.add_argument("--reboot", action="store_true", help="reboot the running kernel first")
+    parser.add_argument("--load-addr", type=lambda s: int(s, 0), default=0x80000)
+    parser.add_argument("--wait", type=float, default=10, help="seconds to wait for the loader")
+    parser.add_argument("--retries", type=int, default=3)
+    args = parser.parse_args()
+
+    with open(args.image, "rb") as f:
+        raw = f.read()
+
+    packed = lz4_compress(raw)
+    lz4_decompress(packed, len(raw))
+
+    fields = struct.pack("<5I", MAGIC, args.load_addr, len(raw), len(packed), zlib.crc32(raw))
+    header = fields + struct.pack("<I", zlib.crc32(fields))
+
+    print("%s: %d bytes, %d compressed (%.0f%%), %.2f s on the wire at %d baud" % (
+        args.image, len(raw), len(packed), 100.0 * len(packed) / max(len(raw), 1),
+        len(packed) * 10 / args.baud, args.baud))
+
+    results = {}
+    threads = [threading.Thread(target=push, args=(port, args, header, packed, results))
+               for port in args.port]
+
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    failed = {port: err for port, err in results.items() if err}
+    for port, err in failed.items():
+        print("[%s] failed: %s" % (port, err))
+
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()
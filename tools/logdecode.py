@@ -0,0 +1,278 @@
+#!/usr/bin/env python3
+"""Decode a serial capture from a LOG_BINARY=1 kernel back into text.
+
+Usage: tools/logdecode.py [uart.bin] [--elf build/kernel8.elf] [--freq 19200000]
+
+The capture has to be raw bytes (e.g. from `cat /dev/ttyUSB0 > uart.bin`).
+Binary log records are expanded using the format strings in the .log_fmt
+section of the ELF. Everything else (printf output, reports) is passed through
+as it is.
+"""
+
+import argparse
+import struct
+import sys
+
+LOG_SYNC = 0xFE
+RECORD_SIZE = 8
+LEVEL_TAGS = "EWID"
+SHT_NOBITS = 8
+SHF_ALLOC = 2
+
+
+def load_sections(elf):
+    with open(elf, "rb") as f:
+        data = f.read()
+
+    if data[:4] != b"\x7fELF" or data[4] != 2:
+        sys.exit("%s: not a 64-bit ELF" % elf)
+
+    shoff, = struct.unpack_from("<Q", data, 0x28)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", data, 0x3A)
+
+    headers = []
+    for i in range(shnum):
+        headers.append(struct.unpack_from("<IIQQQQ", data, shoff + i * shentsize))
+
+    strtab = headers[shstrndx]
+    names = data[strtab[4]:strtab[4] + strtab[5]]
+
+    sections = {}
+    for name, kind, flags, addr, offset, size in headers:
+        name = names[name:names.index(b"\0", name)].decode()
+        contents = b"" if kind == SHT_NOBITS else data[offset:offset + size]
+        sections[name] = (flags, addr, contents)
+
+    return sections
+
+
+class Image:
+    def __init__(self, sections):
+        if ".log_fmt" not in sections:
+            sys.exit("no .log_fmt section, was the kernel built with LOG_BINARY=1?")
+
+        self.fmts = sections[".log_fmt"][2]
+        self.alloc = [(addr, contents) for flags, addr, contents in sections.values()
+                      if flags & SHF_ALLOC and contents]
+
+    def fmt(self, offset):
+        # an id has to point at the start of a string
+        if offset >= len(self.fmts) or (offset and self.fmts[offset - 1] != 0):
+            return None
+        end = self.fmts.index(b"\0", offset)
+        return self.fmts[offset:end].decode(errors="replace")
+
+    def string(self, addr):
+        for base, contents in self.alloc:
+            if base <= addr < base + len(contents):
+                off = addr - base
+                end = contents.find(b"\0", off)
+                return contents[off:end if end >= 0 else len(contents)].decode(errors="replace")
+        return "<%#x>" % addr
+
+
+def parse_fmt(fmt):
+    """Split a tfp_format() string into literals and conversions.
+
+    Follows tfp_format_write(): flags 0 and -, a width in digits or *, a .precision
+    (only %s uses it), h/l/ll/z (every record argument is one 32-bit word anyway)
+    and the conversions d i u x X p c s. Anything else prints nothing and takes no
+    argument, like in the engine.
+    """
+    parts = []
+    i = 0
+    while i < len(fmt):
+        ch = fmt[i]
+        i += 1
+        if ch != "%":
+            parts.append(ch)
+            continue
+        lz = left = False
+        width = 0
+        prec = -1
+        while i < len(fmt) and fmt[i] in "0-":
+            if fmt[i] == "0":
+                lz = True
+            else:
+                left = True
+            i += 1
+        if i < len(fmt) and fmt[i] == "*":
+            width = "*"
+            i += 1
+        else:
+            while i < len(fmt) and fmt[i].isdigit():
+                width = width * 10 + int(fmt[i])
+                i += 1
+        if i < len(fmt) and fmt[i] == ".":
+            i += 1
+            prec = 0
+            while i < len(fmt) and fmt[i].isdigit():
+                prec = prec * 10 + int(fmt[i])
+                i += 1
+        while i < len(fmt) and fmt[i] in "lzh":
+            i += 1
+        if i >= len(fmt):
+            break
+        conv = fmt[i]
+        i += 1
+        if conv in "diuxXpcs":
+            if width == "*":
+                parts.append(("*",))
+            parts.append((lz, left, width, prec, conv))
+        elif conv == "%":
+            parts.append("%")
+    return parts
+
+
+def nargs_of(parts):
+    return sum(1 for p in parts if isinstance(p, tuple))
+
+
+def signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def render(parts, args, image):
+    out = []
+    args = iter(args)
+    star = 0
+    for p in parts:
+        if not isinstance(p, tuple):
+            out.append(p)
+            continue
+        if len(p) == 1:
+            star = signed(next(args))
+            continue
+        lz, left, width, prec, conv = p
+        if width == "*":
+            width = star
+            if width < 0:
+                left = True
+                width = -width
+        value = next(args)
+        prefix = ""
+        if conv == "c":
+            text = chr(value & 0xFF)
+            lz = False
+        elif conv == "s":
+            text = image.string(value) if value else "(null)"
+            if prec >= 0:
+                text = text[:prec]
+            lz = False
+        elif conv in "di":
+            value = signed(value)
+            prefix = "-" if value < 0 else ""
+            text = str(abs(value))
+        elif conv == "u":
+            text = str(value)
+        elif conv == "p":
+            prefix = "0x"
+            text = "%x" % value
+        else:
+            text = ("%X" if conv == "X" else "%x") % value
+        pad = max(width - len(prefix) - len(text), 0)
+        if left:
+            out.append(prefix + text + " " * pad)
+        elif lz:
+            out.append(prefix + "0" * pad + text)
+        else:
+            out.append(" " * pad + prefix + text)
+    return "".join(out)
+
+
+class Decoder:
+    def __init__(self, image, freq):
+        self.image = image
+        self.freq = freq
+        self.parsed = {}
+        self.now = None
+
+    def extend(self, stamp):
+        """Full counter value for a 32-bit stamp.
+
+        The cores drain round-robin, so one core's records can come out a little
+        behind another's. Take the value nearest the newest stamp seen so far: a
+        small step back is interleaving, only a jump of more than half the range
+        is the counter wrapping.
+        """
+        if self.now is None:
+            self.now = stamp
+            return stamp
+
+        full = (self.now & ~0xFFFFFFFF) | stamp
+        if full + (1 << 31) < self.now:
+            full += 1 << 32
+        elif full > self.now + (1 << 31) and full >= 1 << 32:
+            full -= 1 << 32
+
+        self.now = max(self.now, full)
+        return full
+
+    def record(self, data, i):
+        """Expanded text and size of the record at data[i], None if it is not one."""
+        if i + RECORD_SIZE > len(data):
+            return None
+
+        _, info, fmt_id, stamp = struct.unpack_from("<BBHI", data, i)
+        core, level, nargs = info >> 6, (info >> 4) & 3, info & 0xF
+        size = RECORD_SIZE + 4 * nargs
+
+        if nargs > 8 or i + size > len(data):
+            return None
+
+        if fmt_id not in self.parsed:
+            fmt = self.image.fmt(fmt_id)
+            self.parsed[fmt_id] = parse_fmt(fmt) if fmt is not None else None
+
+        parts = self.parsed[fmt_id]
+        if parts is None or nargs_of(parts) != nargs:
+            return None
+
+        args = struct.unpack_from("<%dI" % nargs, data, i + RECORD_SIZE)
+
+        seconds = self.extend(stamp) / self.freq
+
+        text = render(parts, args, self.image)
+        return "[%12.6f] [%s%d] %s" % (seconds, LEVEL_TAGS[level], core, text), size
+
+    def decode(self, data, out):
+        text = bytearray()
+        i = 0
+
+        while i < len(data):
+            if data[i] == LOG_SYNC:
+                hit = self.record(data, i)
+                if hit is not None:
+                    if text:
+                        out.write(text.decode(errors="replace").replace("\r", ""))
+                        text.clear()
+                    out.write(hit[0])
+                    i += hit[1]
+                    continue
+            text.append(data[i])
+            i += 1
+
+        out.write(text.decode(errors="replace").replace("\r", ""))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", nargs="?", help="raw UART capture, stdin if omitted")
+    parser.add_argument("--elf", default="build/kernel8.elf")
+    parser.add_argument("--freq", type=int, default=19200000,
+                        help="generic timer frequency (54000000 on the Pi 4)")
+    args = parser.parse_args()
+
+    image = Image(load_sections(args.elf))
+
+    if args.capture:
+        with open(args.capture, "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    Decoder(image, args.freq).decode(data, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Symbolise a sampling profile dumped by prof_dump() over the UART.
+
+Usage: tools/profile.py [uart.log] [--elf build/kernel8.elf] [--label render]
+
+Reads the PROFILE BEGIN/END blocks from a captured serial log (or stdin) and
+prints a flat profile (self and inclusive samples per function) followed by a
+call graph (callers and callees of every function, gprof style).
+"""
+
+import argparse
+import bisect
+import collections
+import shutil
+import subprocess
+import sys
+
+
+def load_symbols(elf, nm):
+    out = subprocess.run([nm, "-n", "--defined-only", elf],
+                         check=True, capture_output=True, text=True).stdout
+    addrs, names = [], []
+
+    for line in out.splitlines():
+        parts = line.split()
+        if len(parts) != 3 or parts[1] not in "TtWw":
+            continue
+        # mapping symbols ($x, $d) mark code/data, not functions
+        if parts[2].startswith("$"):
+            continue
+        addrs.append(int(parts[0], 16))
+        names.append(parts[2])
+
+    return addrs, names
+
+
+class Symboliser:
+    def __init__(self, addrs, names):
+        self.addrs = addrs
+        self.names = names
+
+    def __call__(self, addr):
+        i = bisect.bisect_right(self.addrs, addr) - 1
+        return self.names[i] if i >= 0 else "0x%x" % addr
+
+
+def parse_blocks(lines):
+    blocks = []
+    block = None
+
+    for line in lines:
+        line = line.strip()
+
+        if line.startswith("PROFILE BEGIN"):
+            fields = dict(f.split("=", 1) for f in line.split()[2:])
+            block = {"label": fields.get("label", ""), "hz": int(fields.get("hz", 0)),
+                     "cores": [], "stacks": []}
+        elif block is None:
+            continue
+        elif line.startswith("C "):
+            core, samples, dropped = (int(x) for x in line.split()[1:4])
+            block["cores"].append((core, samples, dropped))
+        elif line.startswith("S "):
+            parts = line.split()
+            count = int(parts[1])
+            pcs = [int(x, 16) for x in parts[2:]]
+            block["stacks"].append((count, pcs))
+        elif line.startswith("PROFILE END"):
+            blocks.append(block)
+            block = None
+
+    return blocks
+
+
+def frames(pcs, sym):
+    # return addresses point after the bl, step back into the call instruction
+    return [sym(pcs[0])] + [sym(pc - 4) for pc in pcs[1:]]
+
+
+def report(block, sym, top):
+    total = sum(count for count, _ in block["stacks"])
+    self_count = collections.Counter()
+    incl_count = collections.Counter()
+    callers = collections.defaultdict(collections.Counter)
+    callees = collections.defaultdict(collections.Counter)
+
+    for count, pcs in block["stacks"]:
+        stack = frames(pcs, sym)
+
+        self_count[stack[0]] += count
+        for fn in set(stack):
+            incl_count[fn] += count
+
+        # stack[i] was called by stack[i + 1]
+        for callee, caller in zip(stack, stack[1:]):
+            callers[callee][caller] += count
+            callees[caller][callee] += count
+
+    print("== profile '%s': %d samples at %d Hz" % (block["label"], total, block["hz"]))
+    for core, samples, dropped in block["cores"]:
+        print("   core %d: %d samples, %d dropped" % (core, samples, dropped))
+
+    if not total:
+        return
+
+    print()
+    print("Flat profile:")
+    print("   self%   incl%  samples  function")
+    for fn, count in self_count.most_common(top):
+        print("  %6.2f  %6.2f  %7d  %s" % (100.0 * count / total,
+              100.0 * incl_count[fn] / total, count, fn))
+
+    print()
+    print("Call graph (inclusive):")
+    for fn, count in incl_count.most_common(top):
+        print("  %6.2f%%  %s" % (100.0 * count / total, fn))
+        for caller, n in callers[fn].most_common(5):
+            print("            <- %-40s %7d" % (caller, n))
+        for callee, n in callees[fn].most_common(5):
+            print("            -> %-40s %7d" % (callee, n))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", nargs="?", help="captured UART output, stdin if omitted")
+    parser.add_argument("--elf", default="build/kernel8.elf")
+    parser.add_argument("--nm", default=None, help="nm binary (default aarch64-elf-nm, then nm)")
+    parser.add_argument("--label", default=None, help="only the block with this label")
+    parser.add_argument("--top", type=int, default=30)
+    args = parser.parse_args()
+
+    nm = args.nm or shutil.which("aarch64-elf-nm") or "nm"
+    sym = Symboliser(*load_symbols(args.elf, nm))
+
+    with (open(args.log, errors="replace") if args.log else sys.stdin) as f:
+        blocks = parse_blocks(f)
+
+    if args.label is not None:
+        blocks = [b for b in blocks if b["label"] == args.label]
+
+    if not blocks:
+        sys.exit("no PROFILE block found")
+
+    for block in blocks:
+        report(block, sym, args.top)
+        print()
+
+
+if __name__ == "__main__":
+    main()